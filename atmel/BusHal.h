@@ -0,0 +1,45 @@
+// BusHal.h
+// 2026-10-17 RAM bus macros moved here from atmel.ino so the sketch can also be built on Linux
+//
+// Everything atmel.ino does to the two IDT7132 dual port RAMs goes through the macros below
+// and the PORTA, PORTB, PORTC, PINB, DDRB register names.
+// On the ATmega1284 these are the AVR I/O registers.
+// The host build in host/ supplies its own Arduino.h where the same names drive a simulated
+// pair of IDT7132 RAMs with a 6800 on the right hand port, see host/README.md
+//
+// PORTA output Low byte of Address 
+// PORTC output High byte of Address bits 0,1,2 and the control lines on bits 4 to 7
+
+// PORTB alternates between input and output for use by data read and write.
+#define DDRB_Output DDRB = B11111111   // all 1's is output for Atmega1284 PortB to write to IDC-7132 RAM
+#define DDRB_Input DDRB = B00000000    // set Atmega1284 Port B back to high inpeadence input all 0's 
+
+// 2023-02-06 try moving control lines to PORTC Tim Gopaul
+// With control pins moved to Port C the Port D is left for Serial and other un assigned pin functions.
+
+#define CEL2_LOW  PORTC &=B01111111  // ChipEnable Left LOW PORTC PIN_PC7
+#define CEL2_HIGH PORTC |=B10000000  // ChipEnable Left HIGH PORTC PIN_PC7
+
+#define CEL_LOW  PORTC &=B10111111  // ChipEnable Left LOW PORTC PIN_PC6
+#define CEL_HIGH PORTC |=B01000000  // ChipEnable Left HIGH PORTC PIN_PC6
+
+#define RWL_LOW  PORTC &=B11011111  // R/W Left LOW PORTD PIN_PC5
+#define RWL_HIGH PORTC |=B00100000  // R/W Left HIGH PORTD PIN_PC5
+
+#define OEL_LOW  PORTC &=B11101111  // OEL LEFT LOW PORTC PIN_PC4 
+#define OEL_HIGH PORTC |=B00010000  // OEL LEFT HIGH PORTC PIN_PC4 
+
+#define CEL_OEL_LOW   PORTC&=B10101111  // ChipEnable with OutputEnable LOW PORTC PIN_PC6 PIN_PC4
+#define CEL_OEL_HIGH  PORTC|=B01010000  // ChipEnable with OutputEnable HIGH PORTC PIN_PC6  PIN_PC4
+
+#define CEL2_OEL_LOW   PORTC &=B01101111  // ChipEnable with OutputEnable LOW PORTD PIN_PC7 PIN_PC4
+#define CEL2_OEL_HIGH  PORTC |=B10010000  // ChipEnable with OutputEnable HIGH PORTDPIN_PC7  PIN_PC4
+
+// One cycle wait so the RAM output can settle before PINB is read. The host build counts it as one cycle.
+#ifndef BUS_NOP
+#define BUS_NOP __asm__ __volatile__ ("nop\n\t")
+#endif
+
+// True while the left side of the RAM is held off because the 6800 is using the same address
+// BUSY_ is PIN_PD7, a direct PIND bit test is one cycle where digitalRead(BUSY_) took about 3.5 us
+#define BUSY_ACTIVE (!(PIND & B10000000))
@@ -65,6 +65,21 @@
               Subtract
               nullCommand
 
+  2026-10-17  added watchinterval, the ESP32 sets the watch poll period by game phase
+  2026-10-17  added bench and marchtest, Timer1 routine timings and March C- on the shadow RAM
+  2026-10-17  added stats, binary counters frame for the ESP32
+  2026-10-17  validate on without ranges checks the MachineProfile.h score block
+  2026-10-17  added bload and gameBload binary block loader, gamesave and gameload now reach the game RAM,
+              load skips records with a bad checksum or length and echoes each record once
+  2026-10-17  added flight and flightdump, shadow RAM history frozen by a live BUSY fault
+  2026-10-17  added validate, double read and BCD checked samples with torn read counts
+  2026-10-17  added mdump, several ranges in one tagged sample frame
+  2026-10-17  added faultstats, fault log ring buffer and faults per page
+  2026-10-17  busyfaultcount also reports how often an ATmega write had to wait on BUSY_
+  2026-10-17  added diff and gameDiff, delta frames against the previous snapshot
+  2026-10-17  added watch, the ESP32 subscribes to RAM ranges instead of polling
+  2026-10-17  added bdump, binary framed dump for the ESP32
+
   2022-10-18  added commands
               read
               write
@@ -98,21 +113,46 @@
 
 extern volatile unsigned int BusyFaultCount;
 extern volatile unsigned int ShadowFaultCount;
+extern bool validateOn;
+extern byte validateBcdRanges;
+extern unsigned int validateBcdStart[];
+extern unsigned int validateBcdCount[];
+extern unsigned long validateSamples, validateRetries, validateTorn, validateBadBcd, validateFailed;
+extern unsigned int watchInterval;
 
 //Function Prototypes from .ino file
 void writeAddress(unsigned int address, byte dataByte);
 
 byte readAddress(unsigned int address);
+void refreshBuffer(unsigned int addrStart, unsigned int addrCount);
+void gameRefreshBuffer(unsigned int addrStart, unsigned int addrCount);
 void fillRange(unsigned int addrStart, unsigned int addrCount, byte dataByte);
 void fillRandomRange(unsigned int addrStart, unsigned int addrCount);
 void dumpRange(unsigned int addrStart, unsigned int addrCount);
+void bdumpRange(unsigned int addrStart, unsigned int addrCount);
+void watchClear();
+bool watchAdd(unsigned int addrStart, unsigned int addrCount);
+void mdumpRanges(byte id, byte ranges, unsigned int *addrStarts, unsigned int *addrCounts);
+bool diffSetup(bool game, unsigned int addrStart, unsigned int addrCount, unsigned int keyframeEvery, unsigned int intervalMs);
+void diffStop();
+void diffFrame(bool sendEmpty);
 void gameDumpRange(unsigned int addrStart, unsigned int addrCount);
 void dumpBuffRange(unsigned int addrStart, unsigned int addrCount);
 void saveMemory(unsigned int addrStart, unsigned int addrCount);
+void hexWriteBuffer(volatile byte *buffer, unsigned int addrStart, unsigned int addrCount);
+bool flightStart(unsigned int intervalMs);
+void flightStop();
+void flightStatus();
+void flightDumpHex(unsigned int framesBack);
+void flightDumpBin();
 void gameSaveMemory(unsigned int addrStart, unsigned int addrCount);
 void testMemory(unsigned int addrStart, unsigned int addrCount);
 void loadMemory();
 void gameLoadMemory();
+void blockBegin(bool game, unsigned int addrStart, unsigned int addrCount);
+void statsFrame();
+void bench(bool game);
+unsigned long marchTest(unsigned int addrStart, unsigned int addrCount);
 int helpText();
 void testMemory(unsigned int addrStart, unsigned int addrCount, int testLoops);
 
@@ -144,6 +184,17 @@ const char *subtractCommandToken  = "sub";    //Modify here
 const char *readCommandToken      = "read";   // read address ignore
 const char *writeCommandToken     = "write";  // write address byte
 const char *dumpCommandToken      = "dump";   // Dumps memory from starting address with byte count
+const char *bdumpCommandToken     = "bdump";  // Same as dump but sent as a binary frame for the ESP32
+const char *watchCommandToken     = "watch";  // watch addr count [addr count...] push a frame when the range changes
+const char *watchIntervalCommandToken = "watchinterval";  // watchinterval [ms] how often watch re-reads its ranges, no args prints it
+const char *mdumpCommandToken     = "mdump";  // mdump id addr count [addr count...] ranges read together, one frame tagged with id
+const char *validateCommandToken  = "validate";  // validate on [bcdAddr count...] | off | clear, no args prints the counts
+const char *flightCommandToken    = "flight";      // flight on [intervalMs] | off, no args prints the recorder state
+const char *benchCommandToken  = "bench";  // bench [game] Timer1 ns per byte of the shadow RAM reads, game adds writes and the game RAM
+const char *marchTestCommandToken  = "marchtest";  // marchtest [addr count] March C- on the shadow RAM, contents restored after
+const char *statsCommandToken  = "stats";  // sends the fault, BUSY wait and validate counters as a FRAME_TYPE_STATS frame
+const char *flightDumpCommandToken  = "flightdump";  // flightdump hex [framesBack] | bin
+const char *diffCommandToken      = "diff";   // diff addr count [keyframeEvery] [intervalMs] delta frame against the last diff
 const char *dumpBuffCommandToken  = "dumpbuffer";   // Dumps memory held in the buffer
 const char *fillCommandToken      = "fill";    // Fills the RAM starting at address with byte
 const char *fillRandomCommandToken       = "fillrandom";    // Fills with random byte the RAM starting at address with byte
@@ -155,11 +206,15 @@ const char *testMemoryCommandToken       = "testmemory";    // destructive test
 const char *gameReadCommandToken      = "gameread";   // read address ignore
 const char *gameWriteCommandToken     = "gamewrite";  // write address byte
 const char *gameDumpCommandToken  = "gameDump"; // Dumps game memory from starting address with byte count
+const char *gameDiffCommandToken  = "gameDiff"; // diff on the live game RAM
 const char *gameSaveMemoryCommandToken       = "gamesave";    // creates Intel Hex output from ram range.
 const char *gameLoadMemoryCommandToken       = "gameload";    // takes an Intel Hex formatted line and writes it to RAM
+const char *blockLoadCommandToken       = "bload";    // bload addr count, binary blocks with ACK and verify into the shadow RAM
+const char *gameBlockLoadCommandToken       = "gamebload";    // same for the game RAM, only with the pinball powered off
 
 const char *BusyFaultCountToken = "busyfaultcount"; // displays the accumulative count of the busy interrupts
 const char *ShadowFaultCountToken = "shadowfaultcount"; // displays the accumulative count of the busy interrupts
+const char *faultStatsCommandToken = "faultstats";      // faultstats [clear] prints and empties the fault log, per page fault counts
 
 /*************************************************************************************************************
     getCommandLineFromSerialPort()
@@ -188,14 +243,14 @@ getCommandLineFromSerialPort(char * commandLine)
       case BS:                                    // handle backspace in input: put a space in last char
         if (charsRead > 0) {                        //and adjust commandLine and charsRead
           commandLine[--charsRead] = NULLCHAR;
-          Serial.print(" \b"); 
+          Serial.print(F(" \b")); 
         }
         break;
       case ESC:                                    // ESC escape should clear the command line and start over without execiting commad
         if (charsRead > 0) {
           charsRead = 0;                       
           commandLine[charsRead] = NULLCHAR;
-          Serial.print(" ESC\n");
+          Serial.print(F(" ESC\n"));
           inputMode = CommandMode;
           while(Serial.available() > 0) Serial.read(); //eat what's left comming in.
         }
@@ -284,7 +339,7 @@ int subtractCommand() {                                //Modify here
 int readCommand() {                                      //read a byte from RAM
   int address = readNumber();
   byte dataByte = readAddress(address);
-  Serial.printf("0x%04X: 0x%02X\n", address, dataByte);
+  serialPrintf_P(PSTR("0x%04X: 0x%02X\n"), address, dataByte);
   return dataByte; //return the byte but printing is done here
 }
 
@@ -292,9 +347,9 @@ int writeCommand() {                                      //write a byte to RAM
   int address = readNumber();
   int dataByte = readNumber();
   //read before writing
-  Serial.printf("0x%04X: 0x%02X\n", address, readAddress(address));
+  serialPrintf_P(PSTR("0x%04X: 0x%02X\n"), address, readAddress(address));
   writeAddress(address, dataByte);
-  Serial.printf("0x%04X: 0x%02X\n", address, dataByte);
+  serialPrintf_P(PSTR("0x%04X: 0x%02X\n"), address, dataByte);
   return dataByte; //return the byte but printing is done here
 }
 
@@ -307,6 +362,203 @@ int dumpCommand() {
   return addrStart;
 }
 
+int bdumpCommand() {
+  unsigned int addrStart = readNumber();
+  unsigned int addrCount = readNumber();
+
+    bdumpRange(addrStart, addrCount);
+  
+  return addrStart;
+}
+
+// ***** watchCommand *****
+// watch with no arguments stops watching
+int watchCommand() {
+  char * startText;
+  char * countText;
+  int ranges = 0;
+
+  watchClear();
+  while ((startText = readWord()) != NULL) {
+    countText = readWord();
+    if (countText == NULL) {
+      Serial.println(F("> watch needs an address and a count"));
+      break;
+    }
+    unsigned int addrStart = strtol(startText, NULL, 0);
+    unsigned int addrCount = strtol(countText, NULL, 0);
+    if (!watchAdd(addrStart, addrCount)) {
+      serialPrintf_P(PSTR("> watch 0x%04X %d rejected, too many ranges or bytes\n"), addrStart, addrCount);
+      break;
+    }
+    ranges++;
+  }
+  serialPrintf_P(PSTR("> Watching %d ranges\n"), ranges);
+  return ranges;
+}
+
+// ***** watchIntervalCommand *****
+int watchIntervalCommand() {
+  char * intervalText = readWord();
+
+  if (intervalText != NULL) {
+    watchInterval = smaller(bigger(strtol(intervalText, NULL, 0), WATCH_MIN_INTERVAL_MS), WATCH_MAX_INTERVAL_MS);
+  }
+  serialPrintf_P(PSTR("> watch interval %u ms\n"), watchInterval);
+  return watchInterval;
+}
+
+// ***** mdumpCommand *****
+int mdumpCommand() {
+  char * idText = readWord();
+  char * startText;
+  char * countText;
+  unsigned int addrStarts[MDUMP_MAX_RANGES];
+  unsigned int addrCounts[MDUMP_MAX_RANGES];
+  byte ranges = 0;
+
+  if (idText == NULL) {
+    Serial.println(F("> mdump needs an id then address and count pairs"));
+    return 0;
+  }
+  while ((startText = readWord()) != NULL) {
+    countText = readWord();
+    if (countText == NULL || ranges >= MDUMP_MAX_RANGES) {
+      serialPrintf_P(PSTR("> mdump takes up to %d address and count pairs\n"), MDUMP_MAX_RANGES);
+      return 0;
+    }
+    addrStarts[ranges] = strtol(startText, NULL, 0);
+    addrCounts[ranges] = strtol(countText, NULL, 0);
+    ranges++;
+  }
+
+  mdumpRanges((byte)strtol(idText, NULL, 0), ranges, addrStarts, addrCounts);
+  return ranges;
+}
+
+// ***** validateCommand *****
+int validateCommand() {
+  char * optionText = readWord();
+  char * startText;
+  char * countText;
+
+  if (optionText != NULL && strcasecmp(optionText, "on") == 0) {
+    validateBcdRanges = 0;
+    while ((startText = readWord()) != NULL) {
+      countText = readWord();
+      if (countText == NULL || validateBcdRanges >= VALIDATE_MAX_BCD) {
+        serialPrintf_P(PSTR("> validate takes up to %d BCD address and count pairs\n"), VALIDATE_MAX_BCD);
+        break;
+      }
+      validateBcdStart[validateBcdRanges] = strtol(startText, NULL, 0);
+      validateBcdCount[validateBcdRanges] = strtol(countText, NULL, 0);
+      validateBcdRanges++;
+    }
+    if (validateBcdRanges == 0) {                  // the scores of the title the sketch was built for
+      validateBcdStart[0] = machine.scoreAddress;
+      validateBcdCount[0] = profileScoreBlock(machine);
+      validateBcdRanges = 1;
+      serialPrintf_P(PSTR("> %s scores 0x%04X %u\n"), machine.name, validateBcdStart[0], validateBcdCount[0]);
+    }
+    validateOn = true;
+  }
+  else if (optionText != NULL && strcasecmp(optionText, "off") == 0) {
+    validateOn = false;
+  }
+  else if (optionText != NULL && strcasecmp(optionText, "clear") == 0) {
+    validateSamples = validateRetries = validateTorn = validateBadBcd = validateFailed = 0;
+  }
+
+  serialPrintf_P(PSTR("> Validate %s, %d BCD ranges\n"), validateOn ? "on" : "off", validateBcdRanges);
+  serialPrintf_P(PSTR("> samples %lu retries %lu torn %lu badBcd %lu failed %lu\n"),
+                validateSamples, validateRetries, validateTorn, validateBadBcd, validateFailed);
+  return validateOn;
+}
+
+// ***** benchCommand *****
+int benchCommand() {
+  char * optionText = readWord();
+
+  bench(optionText != NULL && strcasecmp(optionText, "game") == 0);
+  return 0;
+}
+
+// ***** marchTestCommand *****
+int marchTestCommand() {
+  char * startText = readWord();
+  char * countText = readWord();
+  unsigned int addrStart = (startText != NULL) ? strtol(startText, NULL, 0) : 0;
+  unsigned int addrCount = (countText != NULL) ? strtol(countText, NULL, 0) : ramSize;
+
+  if (addrStart >= ramSize) {
+    serialPrintf_P(PSTR("> marchtest start 0x%04X is outside the RAM\n"), addrStart);
+    return 0;
+  }
+  return marchTest(addrStart, addrCount) == 0;
+}
+
+// ***** flightCommand *****
+int flightCommand() {
+  char * optionText = readWord();
+  char * intervalText;
+
+  if (optionText != NULL && strcasecmp(optionText, "on") == 0) {
+    intervalText = readWord();
+    unsigned int intervalMs = (intervalText != NULL) ? strtol(intervalText, NULL, 0) : FLIGHT_INTERVAL_MS;
+    if (!flightStart(intervalMs)) Serial.println(F("> diff stream running, flight and diff share one buffer, stop diff first"));
+  }
+  else if (optionText != NULL && strcasecmp(optionText, "off") == 0) {
+    flightStop();
+  }
+  flightStatus();
+  return 0;
+}
+
+// ***** flightDumpCommand *****
+int flightDumpCommand() {
+  char * formatText = readWord();
+  char * backText;
+
+  if (formatText != NULL && strcasecmp(formatText, "bin") == 0) {
+    flightDumpBin();
+  }
+  else if (formatText != NULL && strcasecmp(formatText, "hex") == 0) {
+    backText = readWord();
+    flightDumpHex((backText != NULL) ? strtol(backText, NULL, 0) : 0);
+  }
+  else {
+    Serial.println(F("> flightdump hex [framesBack] or flightdump bin"));
+  }
+  return 0;
+}
+
+// ***** diffCommand *****
+// diff with no arguments stops a streaming diff
+int diffCommand(bool game) {
+  char * startText = readWord();
+  char * countText = readWord();
+  char * keyframeText = readWord();
+  char * intervalText = readWord();
+
+  if (startText == NULL || countText == NULL) {
+    diffStop();
+    Serial.println(F("> diff stopped"));
+    return 0;
+  }
+
+  unsigned int addrStart = strtol(startText, NULL, 0);
+  unsigned int addrCount = strtol(countText, NULL, 0);
+  unsigned int keyframeEvery = (keyframeText != NULL) ? strtol(keyframeText, NULL, 0) : 0;
+  unsigned int intervalMs = (intervalText != NULL) ? strtol(intervalText, NULL, 0) : 0;
+
+  if (!diffSetup(game, addrStart, addrCount, keyframeEvery, intervalMs)) {
+    Serial.println(F("> flight recorder on, flight and diff share one buffer, flight off first"));
+    return 0;
+  }
+  diffFrame(true);
+  return addrStart;
+}
+
 int dumpBuffCommand() {
   unsigned int addrStart = readNumber();
   unsigned int addrCount = readNumber();
@@ -365,6 +617,15 @@ int gameLoadMemoryCommand() {
   return 0;
 }
 
+// ***** blockLoadCommand *****
+int blockLoadCommand(bool game) {
+  unsigned int addrStart = readNumber();
+  unsigned int addrCount = readNumber();
+
+  blockBegin(game, addrStart, addrCount);
+  return 0;
+}
+
 // ***** Help Text *****
 int helpCommand() {
   helpText(); 
@@ -374,7 +635,7 @@ int helpCommand() {
 int gameReadCommand() {                                      //read a byte from RAM
   int address = readNumber();
   byte dataByte = gameReadAddress(address);
-  Serial.printf("0x%04X: 0x%02X\n", address, dataByte);
+  serialPrintf_P(PSTR("0x%04X: 0x%02X\n"), address, dataByte);
   return dataByte; //return the byte but printing is done here
 }
 
@@ -382,9 +643,9 @@ int gameWriteCommand() {                                      //write a byte to
   int address = readNumber();
   int dataByte = readNumber();
   //read before writing
-  Serial.printf("0x%04X: 0x%02X\n", address, readAddress(address));
+  serialPrintf_P(PSTR("0x%04X: 0x%02X\n"), address, readAddress(address));
   gameWriteAddress(address, dataByte);
-  Serial.printf("0x%04X: 0x%02X\n", address, dataByte);
+  serialPrintf_P(PSTR("0x%04X: 0x%02X\n"), address, dataByte);
   return dataByte; //return the byte but printing is done here
 }
 
@@ -398,11 +659,57 @@ int gameDumpCommand() {
 }
 
 void busyFaultCountCommand(){
-  Serial.printf("> Cumlative fault count since last Atmega1284 reboot: %d\n", BusyFaultCount );   
+  serialPrintf_P(PSTR("> Cumlative fault count since last Atmega1284 reboot: %d\n"), BusyFaultCount );   
+  serialPrintf_P(PSTR("> Atmega1284 writes held off by BUSY_, PIND polls: %lu\n"), ramBusyWaits );
 }
 
 void shadowFaultCountCommand(){
-  Serial.printf("> Cumlative fault count since last Atmega1284 reboot: %d\n", ShadowFaultCount );   
+  serialPrintf_P(PSTR("> Cumlative fault count since last Atmega1284 reboot: %d\n"), ShadowFaultCount );   
+}
+
+// ***** faultStatsCommand *****
+// prints the fault events logged since the last faultstats, then the faults per 32 byte page
+// faultstats clear also zeroes the page counts
+int faultStatsCommand(){
+  char * optionText = readWord();
+  bool clear = (optionText != NULL) && (strcasecmp(optionText, "clear") == 0);
+  int events = 0;
+
+  // the ISRs update these 16 bit counters, copy them with interrupts off so a byte can't change between reads
+  noInterrupts();
+  unsigned int liveCount = BusyFaultCount;
+  unsigned int shadowCount = ShadowFaultCount;
+  unsigned int dropped = faultDropped;
+  interrupts();
+
+  serialPrintf_P(PSTR("> Faults live %u shadow %u, log dropped %u\n"), liveCount, shadowCount, dropped);
+  while (faultTail != faultHead) {
+    FaultEvent &event = faultRing[faultTail];
+    serialPrintf_P(PSTR("> %10lu us %-6s 0x%04X %s\n"), event.micros, (event.chip == FAULT_LIVE) ? "live" : "shadow",
+                  event.address, routineNames[event.routine]);
+    faultTail = (faultTail + 1) & (FAULT_RING_SIZE - 1);
+    events++;
+  }
+
+  Serial.println(F("> page            shadow   live"));
+  for (unsigned int page = 0; page < FAULT_PAGES; page++) {
+    noInterrupts();
+    unsigned int shadowFaults = faultPages[FAULT_SHADOW][page];
+    unsigned int liveFaults = faultPages[FAULT_LIVE][page];
+    interrupts();
+    if ((shadowFaults == 0) && (liveFaults == 0)) continue;
+    unsigned int address = page << FAULT_PAGE_SHIFT;
+    serialPrintf_P(PSTR("> 0x%04X-0x%04X %8u %6u\n"), address, address + (1 << FAULT_PAGE_SHIFT) - 1, shadowFaults, liveFaults);
+  }
+
+  if (clear) {
+    noInterrupts();
+    memset((void *)faultPages, 0, sizeof(faultPages));
+    faultDropped = 0;
+    interrupts();
+    Serial.println(F("> fault page counts cleared"));
+  }
+  return events;
 }
 
 // ***** testMemmory *****
@@ -425,22 +732,20 @@ DoMyHexLine(char * HexLine, int writeMode) {
 //  char * endOfFile = ":00000001FF";   //For Intel Hex file transfer a the final line must match.. to switch to command inputMode
 
 
-  Serial.printf("%s\n", HexLine);
-
   int HexLineLength = strlen(HexLine);
 //  Serial.printf("> HexLineLength: 0x%02X\n", HexLineLength);
   if (HexLineLength < 11){
-    Serial.println("> HexLine minimum valid line length is 11 characters");
+    Serial.println(F("> HexLine minimum valid line length is 11 characters"));
   }
   if (HexLine[0]!=':') {
-    Serial.println("> HexLine must start with : character");
+    Serial.println(F("> HexLine must start with : character"));
     }
   if (HexLineLength % 2 == 0) {
-    Serial.println("> HexLine must be odd when including colon start character");
+    Serial.println(F("> HexLine must be odd when including colon start character"));
   }
 
   #define HEXLINEBYTESSIZE MAXHEXLINE *2 + 5
-  byte HexLineBytes[HEXLINEBYTESSIZE];    //Buffer will hold the hex values for input record
+  byte HexLineBytes[HEXLINEBYTESSIZE] = {0};    //Buffer will hold the hex values for input record, zeroed so a short line reads as count 0
   int HLBIndex = 0;
   int checkSum = 0;
 
@@ -453,7 +758,7 @@ DoMyHexLine(char * HexLine, int writeMode) {
     checkSum &= 0xFF;
 //    Serial.printf( " 0x%02X 0x%02X 0x%02X \n", HexLine[i], HexLine[i+1], checkSum);
   }
-  if (checkSum != 0 ) Serial.println("> Bad CheckSum");
+  if (checkSum != 0 ) Serial.println(F("> Bad CheckSum, record not written"));
 
 //Write the bytes to RAM
 //HexLineBytes holds all the byte values from the input HEX ASCII pull off addrCount and addrStart
@@ -467,6 +772,10 @@ DoMyHexLine(char * HexLine, int writeMode) {
   
   if ((checkSum == 0) && (HexLineBytes[0] > 0) && 
      (HexLineBytes[0] < HEXLINEBYTESSIZE) && (recordType == 0)){    
+    if (hexCount + 5 != (unsigned int)HLBIndex) {    //count field has to match the bytes on the line
+      Serial.println(F("> HexLine length does not match its count, record not written"));
+      hexCount = 0;
+    }
     int address = addrStart;
     HLBIndex =4;                                 //Data starts at index 4 in HexLineBytes
     for(unsigned int i = 0; i < hexCount; i++){
@@ -483,14 +792,14 @@ DoMyHexLine(char * HexLine, int writeMode) {
     } 
   }
 
-  Serial.printf("\n> HexLine %s\n", HexLine);
+  serialPrintf_P(PSTR("\n> HexLine %s\n"), HexLine);
   
   if (strcasecmp(HexLine, ":00000001FF") == 0){  //use strcasecmp for case insensitive compare
     inputMode = CommandMode;
-    Serial.println("> Enter Command"); 
+    Serial.println(F("> Enter Command")); 
   }
   else{
-    Serial.println("> Send next Hex record. To terminate: :00000001FF");
+    Serial.println(F("> Send next Hex record. To terminate: :00000001FF"));
   }
   return(true);
 }
@@ -508,11 +817,11 @@ DoMyCommand(char * commandLine) {
 
   if (strcasecmp(ptrToCommandName, addCommandToken) == 0) {                   //Modify here
     result = addCommand();
-    Serial.printf(">    The sum is = %d 0x%04X\n", result, result);
+    serialPrintf_P(PSTR(">    The sum is = %d 0x%04X\n"), result, result);
   } 
   else if (strcasecmp(ptrToCommandName, subtractCommandToken) == 0) {           //Modify here
       result = subtractCommand();                                       
-      Serial.printf(">    The difference is = %d 0x%04X\n", result, result);
+      serialPrintf_P(PSTR(">    The difference is = %d 0x%04X\n"), result, result);
   }
   else if (strcasecmp(ptrToCommandName, readCommandToken) == 0) {           //Modify here
       result = readCommand();                                       
@@ -526,6 +835,40 @@ DoMyCommand(char * commandLine) {
    //   Serial.println();
 
   }
+  else if (strcasecmp(ptrToCommandName, bdumpCommandToken) == 0) {           //Modify here
+      result = bdumpCommand();                                       
+  }
+  else if (strcasecmp(ptrToCommandName, watchCommandToken) == 0) {           //Modify here
+      result = watchCommand();                                       
+  }
+  else if (strcasecmp(ptrToCommandName, watchIntervalCommandToken) == 0) {           //Modify here
+      result = watchIntervalCommand();
+  }
+  else if (strcasecmp(ptrToCommandName, mdumpCommandToken) == 0) {           //Modify here
+      result = mdumpCommand();                                       
+  }
+  else if (strcasecmp(ptrToCommandName, validateCommandToken) == 0) {           //Modify here
+      result = validateCommand();                                       
+  }
+  else if (strcasecmp(ptrToCommandName, flightCommandToken) == 0) {           //Modify here
+      result = flightCommand();                                       
+  }
+  else if (strcasecmp(ptrToCommandName, benchCommandToken) == 0) {           //Modify here
+      result = benchCommand();
+  }
+  else if (strcasecmp(ptrToCommandName, marchTestCommandToken) == 0) {           //Modify here
+      result = marchTestCommand();
+  }
+  else if (strcasecmp(ptrToCommandName, statsCommandToken) == 0) {           //Modify here
+      statsFrame();
+      result = 0;
+  }
+  else if (strcasecmp(ptrToCommandName, flightDumpCommandToken) == 0) {           //Modify here
+      result = flightDumpCommand();                                       
+  }
+  else if (strcasecmp(ptrToCommandName, diffCommandToken) == 0) {           //Modify here
+      result = diffCommand(false);                                       
+  }
 
   else if (strcasecmp(ptrToCommandName, gameReadCommandToken) == 0) {           //Modify here
       result = gameReadCommand();                                       
@@ -539,6 +882,9 @@ DoMyCommand(char * commandLine) {
    //   Serial.println();
 
   }
+  else if (strcasecmp(ptrToCommandName, gameDiffCommandToken) == 0) {           //Modify here
+      result = diffCommand(true);                                       
+  }
   else if (strcasecmp(ptrToCommandName, dumpBuffCommandToken) == 0) {           //Modify here
       result = dumpBuffCommand();                                       
       Serial.println();
@@ -560,11 +906,17 @@ DoMyCommand(char * commandLine) {
       result = loadMemoryCommand();                                       
   }
   else if (strcasecmp(ptrToCommandName, gameSaveMemoryCommandToken) == 0) {           //Modify here
-      result = saveMemoryCommand();                                       
+      result = gameSaveMemoryCommand();                                       
       Serial.println();
   }
   else if (strcasecmp(ptrToCommandName, gameLoadMemoryCommandToken) == 0) {           //Modify here
-      result = loadMemoryCommand();                                       
+      result = gameLoadMemoryCommand();                                       
+  }
+  else if (strcasecmp(ptrToCommandName, blockLoadCommandToken) == 0) {           //Modify here
+      result = blockLoadCommand(false);                                       
+  }
+  else if (strcasecmp(ptrToCommandName, gameBlockLoadCommandToken) == 0) {           //Modify here
+      result = blockLoadCommand(true);                                       
   }
   else if (strcasecmp(ptrToCommandName, helpCommandToken) == 0) {           //Modify here
       result = helpText();                                       
@@ -581,6 +933,9 @@ DoMyCommand(char * commandLine) {
   else if (strcasecmp(ptrToCommandName, ShadowFaultCountToken) == 0) {           //Modify here
       shadowFaultCountCommand();                                       
   }
+  else if (strcasecmp(ptrToCommandName, faultStatsCommandToken) == 0) {           //Modify here
+      result = faultStatsCommand();
+  }
   
   else {
       nullCommand(ptrToCommandName);
@@ -0,0 +1,207 @@
+// RamAccess.h
+// 2026-10-17 one access layer for both IDT7132 RAMs, chip and direction are template parameters
+//
+// The shadow and live game RAM only differ in which PORTC bit is their chip enable.
+// With the CE mask as a template parameter the compiler folds every mask into a constant, so each
+// instance is as tight as the hand copied shadow and game routines it replaces.
+//
+// PORTC holds the address high bits and the control lines together. Each routine works out the PORTC
+// value with controls idle and the value with CE (and OE or RW) low, then writes whole bytes with a
+// single out instruction instead of a read modify write on the port. That keeps CE low only for the
+// nops the RAM needs and the PINB read or BUSY_ check.
+//
+// Templates live in a header because the Arduino prototype generator doesn't handle them in the .ino
+
+#define RAM_SHADOW B01000000   // CEL_  PIN_PC6 shadow RAM, safe to read while the game runs
+#define RAM_GAME   B10000000   // CEL2_ PIN_PC7 live game RAM
+#define RAM_OE     B00010000   // OEL_  PIN_PC4
+#define RAM_RW     B00100000   // RWL_  PIN_PC5
+#define RAM_IDLE   0xF8        // control lines all high, upper PORTC bits
+
+#define RAM_READ  false
+#define RAM_WRITE true
+
+volatile unsigned long ramBusyWaits = 0;   // PIND polls that found BUSY_ low during an ATmega write
+
+// ***** ramAccess *****
+// one byte read or write, returns the byte read or the byte written
+template <byte chip, bool write>
+inline byte ramAccess(unsigned int address, byte dataByte = 0){
+  byte idle = highByte(address) | RAM_IDLE;
+
+  PORTC = idle;                   // address high bits, control lines high
+  PORTA = lowByte(address);
+
+  if (write) {
+    DDRB_Output;
+    PORTB = dataByte;
+    PORTC = idle & ~(chip | RAM_RW);   // CE and RW low together, write is timed from here
+    BUS_NOP;                           // give BUSY_ time to come back from the RAM before testing it
+    BUS_NOP;
+    while (BUSY_ACTIVE) {              // 6800 has this address, the write lands when it lets go
+      ++ramBusyWaits;
+    }
+    PORTC = idle;                      // CE and RW rise together, data still held on PORTB
+    DDRB_Input;
+  }
+  else {
+    PORTC = idle & ~(chip | RAM_OE);
+    BUS_NOP;                           // two nops, same 312 ns read as the original routines
+    BUS_NOP;
+    dataByte = PINB;
+    PORTC = idle;
+  }
+  return dataByte;
+}
+
+// ***** ramReadBurst *****
+// read addrStart up to addrEnd into buffer. The address high bits only change every 256 bytes, so the
+// PORTC values are worked out once per page and each byte is just PORTA, CE low, PINB, CE high.
+template <byte chip>
+void ramReadBurst(unsigned int addrStart, unsigned int addrEnd, volatile byte *buffer){
+  unsigned int address = addrStart;
+
+  while (address < addrEnd) {
+    byte idle = highByte(address) | RAM_IDLE;
+    byte select = idle & ~(chip | RAM_OE);
+    unsigned int pageEnd = (address | 0x00FF) + 1;
+    if (pageEnd > addrEnd) pageEnd = addrEnd;
+
+    PORTC = idle;
+    for (; address < pageEnd; address++) {
+      PORTA = lowByte(address);
+      PORTC = select;
+      BUS_NOP;
+      BUS_NOP;
+      byte dataByte = PINB;
+      PORTC = idle;                    // deselect before the store to the buffer
+      buffer[address] = dataByte;
+    }
+  }
+}
+
+// ***** ramVerifyBurst *****
+// read addrStart up to addrEnd again and compare with buffer, false at the first byte that differs
+template <byte chip>
+bool ramVerifyBurst(unsigned int addrStart, unsigned int addrEnd, const volatile byte *buffer){
+  unsigned int address = addrStart;
+
+  while (address < addrEnd) {
+    byte idle = highByte(address) | RAM_IDLE;
+    byte select = idle & ~(chip | RAM_OE);
+    unsigned int pageEnd = (address | 0x00FF) + 1;
+    if (pageEnd > addrEnd) pageEnd = addrEnd;
+
+    PORTC = idle;
+    for (; address < pageEnd; address++) {
+      PORTA = lowByte(address);
+      PORTC = select;
+      BUS_NOP;
+      BUS_NOP;
+      byte dataByte = PINB;
+      PORTC = idle;
+      if (dataByte != buffer[address]) return false;
+    }
+  }
+  return true;
+}
+
+// ***** ramWriteBurst *****
+// write buffer[addrStart] up to buffer[addrEnd - 1] to the same addresses
+template <byte chip>
+void ramWriteBurst(unsigned int addrStart, unsigned int addrEnd, const volatile byte *buffer){
+  unsigned int address = addrStart;
+
+  DDRB_Output;
+  while (address < addrEnd) {
+    byte idle = highByte(address) | RAM_IDLE;
+    byte select = idle & ~(chip | RAM_RW);
+    unsigned int pageEnd = (address | 0x00FF) + 1;
+    if (pageEnd > addrEnd) pageEnd = addrEnd;
+
+    PORTC = idle;
+    for (; address < pageEnd; address++) {
+      PORTB = buffer[address];         // before CE goes low
+      PORTA = lowByte(address);
+      PORTC = select;
+      BUS_NOP;
+      BUS_NOP;
+      while (BUSY_ACTIVE) {
+        ++ramBusyWaits;
+      }
+      PORTC = idle;
+    }
+  }
+  DDRB_Input;
+}
+
+// ***** ramFillBurst *****
+// write dataByte to addrStart up to addrEnd, or random bytes when randomFill is set
+template <byte chip>
+void ramFillBurst(unsigned int addrStart, unsigned int addrEnd, byte dataByte, bool randomFill){
+  unsigned int address = addrStart;
+
+  DDRB_Output;
+  PORTB = dataByte;
+  while (address < addrEnd) {
+    byte idle = highByte(address) | RAM_IDLE;
+    byte select = idle & ~(chip | RAM_RW);
+    unsigned int pageEnd = (address | 0x00FF) + 1;
+    if (pageEnd > addrEnd) pageEnd = addrEnd;
+
+    PORTC = idle;
+    for (; address < pageEnd; address++) {
+      if (randomFill) PORTB = (byte)random(0x100);   // before CE goes low, random() is slow
+      PORTA = lowByte(address);
+      PORTC = select;
+      BUS_NOP;
+      BUS_NOP;
+      while (BUSY_ACTIVE) {
+        ++ramBusyWaits;
+      }
+      PORTC = idle;
+    }
+  }
+  DDRB_Input;
+}
+
+// ***** ramTimeBlock *****
+// run one routine over addrStart up to addrEnd with interrupts off and return the Timer1 counts it took.
+// The caller has Timer1 running at clk/1 and keeps the block short enough that TCNT1 doesn't wrap.
+// Reads land in buffer, writes and the burst write send buffer, fill writes 0x00.
+#define RAM_TIME_NONE 0                // just the timer reads, subtracted from the others
+#define RAM_TIME_READ 1                // ramAccess one byte at a time
+#define RAM_TIME_BURST_READ 2
+#define RAM_TIME_WRITE 3               // ramAccess one byte at a time
+#define RAM_TIME_BURST_WRITE 4
+#define RAM_TIME_FILL 5
+
+template <byte chip>
+unsigned int ramTimeBlock(byte routine, unsigned int addrStart, unsigned int addrEnd, volatile byte *buffer){
+  noInterrupts();
+  unsigned int start = TCNT1;
+  switch (routine) {
+    case RAM_TIME_READ:
+      for (unsigned int address = addrStart; address < addrEnd; address++) {
+        buffer[address] = ramAccess<chip, RAM_READ>(address);
+      }
+      break;
+    case RAM_TIME_BURST_READ:
+      ramReadBurst<chip>(addrStart, addrEnd, buffer);
+      break;
+    case RAM_TIME_WRITE:
+      for (unsigned int address = addrStart; address < addrEnd; address++) {
+        ramAccess<chip, RAM_WRITE>(address, buffer[address]);
+      }
+      break;
+    case RAM_TIME_BURST_WRITE:
+      ramWriteBurst<chip>(addrStart, addrEnd, buffer);
+      break;
+    case RAM_TIME_FILL:
+      ramFillBurst<chip>(addrStart, addrEnd, 0x00, false);
+      break;
+  }
+  unsigned int counts = (uint16_t)(TCNT1 - start);
+  interrupts();
+  return counts;
+}
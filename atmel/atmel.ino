@@ -1,6 +1,20 @@
 // Protospace is running code version PinBallMemoryPort20230201
 // The next version of code starts dated 2023 02 05
 // 
+// 2026-10-17 watchinterval command, the ESP32 slows watch polling while the pinball is idle and speeds it up in play
+// 2026-10-17 bench times the shadow RAM reads with Timer1, bench game adds the writes and the game RAM, marchtest runs March C- on the shadow RAM
+// 2026-10-17 stats command sends fault, BUSY wait and validate counters as one frame for the ESP32 /metrics page
+// 2026-10-17 validate on with no ranges checks the score block from MachineProfile.h, the layout the ESP32 decodes with
+// 2026-10-17 bload and gameBload take 256 byte binary blocks with CRC, ACK/NAK and verify, gamesave/gameload go to the game RAM
+// 2026-10-17 flight recorder keeps a rolling undo log of the shadow RAM, a live BUSY fault freezes it, flightdump reads it back
+// 2026-10-17 validate command, watch and mdump samples are read twice until both reads match and score bytes are valid BCD
+// 2026-10-17 mdump reads several ranges back to back and sends them as one tagged sample frame, watch pushes the same frame
+// 2026-10-17 fault ISRs log time, address and active routine to a ring buffer and a per page count, faultstats prints them
+// 2026-10-17 read/write/refresh/fill routines for both RAMs share the RamAccess.h templates, BUSY_ is a PIND bit test
+// 2026-10-17 RAM bus macros moved to BusHal.h, host/ builds this sketch on Linux against a simulated IDT7132
+// 2026-10-17 diff and gameDiff commands send run length delta records against the previous snapshot, with optional keyframes
+// 2026-10-17 watch command, loop() re-reads the watched ranges and pushes a frame only when a byte changed
+// 2026-10-17 bdump command sends RAM as a binary CRC checked frame for the ESP32, dump stays ASCII for humans
 // 2023-02-19 Tim Gopaul, gameSave and gameLoad added to access game Ram.. only to be used when Pinball machine is powered off
 // 2023-02-18 Tim Gopaul, trouble getting PCINT30 working. changed to interrup Pin = PIN_PD2 which gives digitalPinToInterrupt(interruptPin) as 0
 // 2023-02-14 Tim Gopaul, attach an interrupt low edge to pin 20 PD6 PCINT30
@@ -60,38 +74,72 @@
 
 
 #define MAXHEXLINE 16         // for Hex record length
+#define FRAME_SYNC 0xA5       // first byte of a binary frame, never appears in the ASCII command output
+#define FRAME_TYPE_DUMP 'D'   // bdump frame, payload is address high, address low then the data bytes
+#define FRAME_TYPE_SAMPLE 'M' // mdump and watch frame, payload is id, flags, range count then for each range address high, address low, count low, count high and the data bytes
+#define FRAME_TYPE_FLIGHT 'F' // flightdump bin frame, see Flight recorder
+#define FRAME_TYPE_BLOCK 'B'  // bload block from the host, payload is address high, address low then the data bytes
+#define FRAME_TYPE_ACK 'A'    // bload reply, payload is status, next address high, next address low
+#define FRAME_TYPE_STOP 'X'   // bload stop from the host, empty payload
+#define FRAME_TYPE_STATS 'S'  // stats reply, payload is a field count then that many 32 bit counters, low byte first
+#define SAMPLE_VALIDATED 0x01 // sample flag, two reads matched and the BCD ranges hold valid BCD
+#define FRAME_TYPE_KEYFRAME 'K' // diff keyframe, payload is sequence, address high, address low then the data bytes
+#define FRAME_TYPE_DELTA 'd'  // diff delta, payload is sequence then records of address high, address low, length, data bytes
+#define DIFF_MERGE_GAP 3      // unchanged bytes shorter than a record header are sent inside the run instead
+#define WATCH_MAX_RANGES 4    // watch <addr> <count> pairs that fit on the command line
+#define MDUMP_MAX_RANGES 4    // mdump <addr> <count> pairs
+#define WATCH_SAMPLE_ID 0     // sample id of frames pushed by watch, mdump ids from the ESP32 start at 1
+#define VALIDATE_MAX_TRIES 4  // reads of a sample before giving up on it
+#define VALIDATE_MAX_BCD 4    // validate on <addr> <count> pairs checked as BCD
+#define FLIGHT_LOG_SIZE 2048  // flight recorder undo log, power of two. SRAM is about 10K of static data with this,
+                              // four 2K buffers, so keep new buffers small and strings in flash
+#define FLIGHT_HEADER 6       // frame length and millis at the start of each flight log frame
+#define FLIGHT_POST_FRAMES 8  // reads still recorded after a live BUSY fault before freezing
+#define FLIGHT_INTERVAL_MS 20 // default time between flight recorder reads
+#define FLIGHT_OFF 0
+#define FLIGHT_RECORDING 1
+#define FLIGHT_FROZEN 2
+#define WATCH_BUFFER_SIZE 64  // total watched bytes, last value sent is kept here to compare against
+#define WATCH_INTERVAL_MS 10  // how often loop() re-reads the watched ranges, until watchinterval changes it
+#define WATCH_MIN_INTERVAL_MS 2
+#define WATCH_MAX_INTERVAL_MS 1000
+#define BLOCK_MAX_DATA 256    // data bytes in one bload block
+#define BLOCK_TIMEOUT_MS 2000 // bload gives up and returns to command input after this long without a byte
+#define BLOCK_OK 0            // block written and verified, or ready for the first block
+#define BLOCK_BAD_CRC 1       // frame damaged, send the same block again
+#define BLOCK_BAD_ADDRESS 2   // block is not the one expected, send the block at the next address
+#define BLOCK_VERIFY_FAILED 3 // read back differs, send the same block again
+#define BENCH_BLOCK 256       // bytes bench times at once, Timer1 at clk/1 wraps after 256 cycles a byte
+#define MARCH_MAX_REPORT 8    // marchtest prints this many errors, the rest are only counted
+#define PRINTF_BUFFER_SIZE 128  // longest line serialPrintf_P prints, longer ones are cut short
 const int ramSize =  2048;    // don't change this without also defining address bits PORTC has limited bits available 
 
 #define CommandMode 1         // inputMode will flip between command and data entry, commands defined in CommandLine.h file
 #define DataMode 2            // 2023-01-09 Tim Gopaul.. in DataMode the UART stream is read as an Intel HEX file
 #define gameDataMode 3            // 2023-01-09 Tim Gopaul.. in DataMode the UART stream is read as an Intel HEX file
+#define BlockMode 4           // bload, the UART stream is binary FRAME_TYPE_BLOCK frames for the shadow RAM
+#define gameBlockMode 5       // gameBload, the same for the live game RAM
 
 int inputMode = CommandMode;  // on startup the input is waiting for commands
 
-// PORTB alternates between input and output for use by data read and write.
-#define DDRB_Output DDRB = B11111111   // all 1's is output for Atmega1284 PortB to write to IDC-7132 RAM
-#define DDRB_Input DDRB = B00000000    // set Atmega1284 Port B back to high inpeadence input all 0's 
-
-// 2023-02-06 try moving control lines to PORTC Tim Gopaul
-// With control pins moved to Port C the Port D is left for Serial and other un assigned pin functions.
-
-#define CEL2_LOW  PORTC &=B01111111  // ChipEnable Left LOW PORTC PIN_PC7
-#define CEL2_HIGH PORTC |=B10000000  // ChipEnable Left HIGH PORTC PIN_PC7
-
-#define CEL_LOW  PORTC &=B10111111  // ChipEnable Left LOW PORTC PIN_PC6
-#define CEL_HIGH PORTC |=B01000000  // ChipEnable Left HIGH PORTC PIN_PC6
-
-#define RWL_LOW  PORTC &=B11011111  // R/W Left LOW PORTD PIN_PC5
-#define RWL_HIGH PORTC |=B00100000  // R/W Left HIGH PORTD PIN_PC5
-
-#define OEL_LOW  PORTC &=B11101111  // OEL LEFT LOW PORTC PIN_PC4 
-#define OEL_HIGH PORTC |=B00010000  // OEL LEFT HIGH PORTC PIN_PC4 
-
-#define CEL_OEL_LOW   PORTC&=B10101111  // ChipEnable with OutputEnable LOW PORTC PIN_PC6 PIN_PC4
-#define CEL_OEL_HIGH  PORTC|=B01010000  // ChipEnable with OutputEnable HIGH PORTC PIN_PC6  PIN_PC4
-
-#define CEL2_OEL_LOW   PORTC &=B01101111  // ChipEnable with OutputEnable LOW PORTD PIN_PC7 PIN_PC4
-#define CEL2_OEL_HIGH  PORTC |=B10010000  // ChipEnable with OutputEnable HIGH PORTDPIN_PC7  PIN_PC4
+#include "BusHal.h"          // RAM control line macros, PORT and PIN register use
+#include "RamAccess.h"       // ramAccess and burst kernels templated on chip enable and direction
+#include <MachineProfile.h>   // libraries/MachineProfile, game RAM layout shared with the ESP32
+#include <stdarg.h>
+
+// ***** serialPrintf_P *****
+// Serial.printf with the format in flash. On AVR a plain string literal is copied to SRAM at startup,
+// so every format goes through PSTR() and every fixed line through F(), the 16K is for the RAM buffers.
+int serialPrintf_P(PGM_P format, ...){
+  char text[PRINTF_BUFFER_SIZE];
+  va_list args;
+
+  va_start(args, format);
+  int length = vsnprintf_P(text, sizeof(text), format, args);
+  va_end(args);
+  Serial.write(text);
+  return length;
+}
 
 
 const byte BUSY_ = PIN_PD7;        // BUSY#  input pull up This is for the Atmega side Busy signals
@@ -106,6 +154,84 @@ volatile byte ShadowStateIRQ = HIGH;
 volatile unsigned int ShadowFaultAddress;
 volatile unsigned int ShadowFaultCount = 0;   // count the number of busy faults and report when given the BusyFaultCount command 
 
+// ***** Fault log *****
+// Both fault ISRs add an event to faultRing and bump a per page count in faultPages so faultstats can show
+// which of our reads run into the 6800, the stack near 0x01E0 is the worry.
+// The ISRs are the only writers of faultHead and faultstats is the only writer of faultTail, both single bytes,
+// so the ring needs no locking. When the ring is full new events are only counted in faultDropped.
+// The address is where PORTC and PORTA are when the ISR runs. The ISR starts a couple of microseconds after
+// BUSY_ so a burst read may have moved a few bytes on, the 32 byte pages absorb that.
+
+#define FAULT_RING_SIZE 32           // power of two
+#define FAULT_PAGE_SHIFT 5           // 32 byte pages
+#define FAULT_PAGES (ramSize >> FAULT_PAGE_SHIFT)
+#define FAULT_SHADOW 0
+#define FAULT_LIVE 1
+#define RAM_ADDRESS_HIGH_MASK 0x07   // PORTC bits 0,1,2 are address bits 8,9,10
+
+// what the ATmega was doing with the RAM, set around each RAM access so the ISR can record it
+#define ROUTINE_IDLE 0
+#define ROUTINE_READ 1
+#define ROUTINE_WRITE 2
+#define ROUTINE_REFRESH 3
+#define ROUTINE_FILL 4
+#define ROUTINE_BDUMP 5
+#define ROUTINE_WATCH 6
+#define ROUTINE_DIFF 7
+#define ROUTINE_TEST 8
+#define ROUTINE_MDUMP 9
+#define ROUTINE_FLIGHT 10
+#define ROUTINE_BENCH 11
+#define ROUTINE_MARCH 12
+const char *routineNames[] = { "idle", "read", "write", "refresh", "fill", "bdump", "watch", "diff", "testmemory", "mdump", "flight",
+                               "bench", "marchtest" };
+
+struct FaultEvent {
+  unsigned long micros;
+  unsigned int address;
+  byte chip;                          // FAULT_SHADOW or FAULT_LIVE
+  byte routine;
+};
+
+FaultEvent faultRing[FAULT_RING_SIZE];
+volatile byte faultHead = 0;          // next slot the ISR fills
+volatile byte faultTail = 0;          // next slot faultstats prints
+volatile unsigned int faultDropped = 0;
+volatile unsigned int faultPages[2][FAULT_PAGES];
+volatile byte activeRoutine = ROUTINE_IDLE;
+
+// ***** routineBegin *****
+// the outermost caller names the routine, so a watch read shows as watch rather than refresh
+byte routineBegin(byte routine){
+  byte previous = activeRoutine;
+  if (previous == ROUTINE_IDLE) activeRoutine = routine;
+  return previous;
+}
+
+// ***** routineEnd *****
+void routineEnd(byte previous){
+  activeRoutine = previous;
+}
+
+// ***** faultLog *****
+// called from the fault ISRs only
+void faultLog(byte chip, unsigned int address){
+  byte next = (faultHead + 1) & (FAULT_RING_SIZE - 1);
+  if (next != faultTail) {
+    FaultEvent &event = faultRing[faultHead];
+    event.micros = micros();
+    event.address = address;
+    event.chip = chip;
+    event.routine = activeRoutine;
+    faultHead = next;
+  }
+  else if (faultDropped < 0xFFFF) {
+    ++faultDropped;
+  }
+
+  if (faultPages[chip][address >> FAULT_PAGE_SHIFT] < 0xFFFF) ++faultPages[chip][address >> FAULT_PAGE_SHIFT];
+}
+
 
 volatile byte ramBuffer[ramSize];   // This is an array to hold the contents of memory
                            // Is there enough RAM to hold this on an ATMEGA1284? yes16KBytes
@@ -126,57 +252,91 @@ void ramBufferInit(){
 
 // ****** helpText *****
 int helpText(){
-  Serial.println(">****************************************");
-  Serial.println(">*                                      *");
-  Serial.printf(">*   Compile Date: %s\n", __DATE__ );
-  Serial.printf(">*   Compile Time: %s\n", __TIME__ );
-  Serial.println(">*                                      *");
-  Serial.println(">*   Utility to read Pinball RAM        *");
-  Serial.println(">*   Tim Gopaul for Protospace          *");
-  Serial.println(">*                                      *");
-  Serial.println(">*   Enter numbers as baseTen,or        *");
-  Serial.println(">*   Enter as 0xNN for hex format       *");
-  Serial.println(">*                                      *");
-  Serial.println(">*   add   integer integer              *");
-  Serial.println(">*   sub   integer integer              *");
-  Serial.println(">*   read  address                      *");
-  Serial.println(">*   write address databyte             *");
-  Serial.println(">*   dump  start count                  *");
-  Serial.println(">*   dumpBuffer  start count            *");
-  Serial.println(">*   fill  start count databyte         *");
-  Serial.println(">*   fillRandom  start count            *");
-  Serial.println(">*   save startAddress count            *");
-  Serial.println(">*   load Intelhex record line          *");
-  Serial.println(">*   testMemory start count             *");
-  Serial.println(">*                                      *");
-  Serial.println(">*   game commands work directly        *");
-  Serial.println(">*   Game RAM.                          *");
-  Serial.println(">*   Use only when pinball off          *");
-  Serial.println(">*                                      *");
+  Serial.println(F(">****************************************"));
+  Serial.println(F(">*                                      *"));
+  serialPrintf_P(PSTR(">*   Compile Date: %s\n"), __DATE__ );
+  serialPrintf_P(PSTR(">*   Compile Time: %s\n"), __TIME__ );
+  Serial.println(F(">*                                      *"));
+  Serial.println(F(">*   Utility to read Pinball RAM        *"));
+  Serial.println(F(">*   Tim Gopaul for Protospace          *"));
+  Serial.println(F(">*                                      *"));
+  Serial.println(F(">*   Enter numbers as baseTen,or        *"));
+  Serial.println(F(">*   Enter as 0xNN for hex format       *"));
+  Serial.println(F(">*                                      *"));
+  Serial.println(F(">*   add   integer integer              *"));
+  Serial.println(F(">*   sub   integer integer              *"));
+  Serial.println(F(">*   read  address                      *"));
+  Serial.println(F(">*   write address databyte             *"));
+  Serial.println(F(">*   dump  start count                  *"));
+  Serial.println(F(">*   bdump start count  binary frame    *"));
+  Serial.println(F(">*   watch start count [start count..]  *"));
+  Serial.println(F(">*     push frames on change, no args   *"));
+  Serial.println(F(">*     stops watching                   *"));
+  Serial.println(F(">*   watchInterval [ms] poll period     *"));
+  Serial.println(F(">*   mdump id start count [start count] *"));
+  Serial.println(F(">*     one frame, ranges read together  *"));
+  Serial.println(F(">*   validate on [bcdStart count]|off   *"));
+  Serial.println(F(">*     read samples twice, check BCD    *"));
+  Serial.println(F(">*     no ranges: the profile scores    *"));
+  Serial.println(F(">*     no args prints torn read counts  *"));
+  Serial.println(F(">*   diff start count [keyEvery] [ms]   *"));
+  Serial.println(F(">*     delta frames, ms keeps streaming *"));
+  Serial.println(F(">*     diff with no args stops stream   *"));
+  Serial.println(F(">*   dumpBuffer  start count            *"));
+  Serial.println(F(">*   fill  start count databyte         *"));
+  Serial.println(F(">*   fillRandom  start count            *"));
+  Serial.println(F(">*   save startAddress count            *"));
+  Serial.println(F(">*   load Intelhex record line          *"));
+  Serial.println(F(">*   bload start count  binary blocks   *"));
+  Serial.println(F(">*     use tools/blockload.py           *"));
+  Serial.println(F(">*   testMemory start count             *"));
+  Serial.println(F(">*                                      *"));
+  Serial.println(F(">*   game commands work directly        *"));
+  Serial.println(F(">*   Game RAM.                          *"));
+  Serial.println(F(">*   Use only when pinball off          *"));
+  Serial.println(F(">*                                      *"));
   
-  Serial.println(">*   Use game commands for direct access*");
-  Serial.println(">*    to the live game Ram when Pinball *");
-  Serial.println(">*    is powered off.                   *");  
-  Serial.println(">*   gameRead address                   *");
-  Serial.println(">*   gameWrite address databyte         *");
-  Serial.println(">*   gameDump start count               *");
-  Serial.println(">*   gameSave startAddress count        *");
-  Serial.println(">*   gameLoad Intelhex record line      *");
-  Serial.println(">*                                      *");  
-  Serial.println(">*                                      *");
-  Serial.println(">*   Enter numbers as decimal or        *");
-  Serial.println(">*   0xNN  0X55 for HEX                 *");
-  Serial.println(">*                                      *");
-  Serial.println(">*   BusyFaultCount will give the       *");
-  Serial.println(">*   count of Busy Interruptes          *");
-  Serial.println(">*   PIN_PD2 IRQ 0                      *");
-  Serial.println(">*                                      *");
-  Serial.println(">*   ShadowFaultCount gives the         *");
-  Serial.println(">*   count of Shadow Busy Interruptes   *");
-  Serial.println(">*   PIN_PD3 IRQ 1                      *");
-  Serial.println(">*                                      *");
-  Serial.println(">*                                      *");
-  Serial.println(">****************************************");
+  Serial.println(F(">*   Use game commands for direct access*"));
+  Serial.println(F(">*    to the live game Ram when Pinball *"));
+  Serial.println(F(">*    is powered off.                   *"));  
+  Serial.println(F(">*   gameRead address                   *"));
+  Serial.println(F(">*   gameWrite address databyte         *"));
+  Serial.println(F(">*   gameDump start count               *"));
+  Serial.println(F(">*   gameDiff start count [key] [ms]    *"));
+  Serial.println(F(">*   gameSave startAddress count        *"));
+  Serial.println(F(">*   gameLoad Intelhex record line      *"));
+  Serial.println(F(">*   gameBload start count              *"));
+  Serial.println(F(">*                                      *"));  
+  Serial.println(F(">*                                      *"));
+  Serial.println(F(">*   Enter numbers as decimal or        *"));
+  Serial.println(F(">*   0xNN  0X55 for HEX                 *"));
+  Serial.println(F(">*                                      *"));
+  Serial.println(F(">*   BusyFaultCount will give the       *"));
+  Serial.println(F(">*   count of Busy Interruptes          *"));
+  Serial.println(F(">*   PIN_PD2 IRQ 0                      *"));
+  Serial.println(F(">*                                      *"));
+  Serial.println(F(">*   ShadowFaultCount gives the         *"));
+  Serial.println(F(">*   count of Shadow Busy Interruptes   *"));
+  Serial.println(F(">*   PIN_PD3 IRQ 1                      *"));
+  Serial.println(F(">*                                      *"));
+  Serial.println(F(">*   faultStats [clear] time, address   *"));
+  Serial.println(F(">*   and routine of each fault, plus    *"));
+  Serial.println(F(">*   faults per 32 byte page            *"));
+  Serial.println(F(">*   stats  counters as one binary      *"));
+  Serial.println(F(">*   frame for the ESP32                *"));
+  Serial.println(F(">*                                      *"));
+  Serial.println(F(">*   bench [game] ns per byte of the    *"));
+  Serial.println(F(">*     shadow RAM reads, game adds the  *"));
+  Serial.println(F(">*     writes and the game RAM, only    *"));
+  Serial.println(F(">*     with the pinball powered off     *"));
+  Serial.println(F(">*   marchTest [start count] March C-   *"));
+  Serial.println(F(">*     on the shadow RAM, pinball off   *"));
+  Serial.println(F(">*                                      *"));
+  Serial.println(F(">*   flight [on [ms] | off] RAM history *"));
+  Serial.println(F(">*   frozen by a live BUSY fault        *"));
+  Serial.println(F(">*   flightDump hex [framesBack] | bin  *"));
+  Serial.println(F(">*                                      *"));
+  Serial.println(F(">****************************************"));
   Serial.println();  
   return(0);
 }
@@ -185,61 +345,31 @@ unsigned int smaller( unsigned int a, unsigned int b){
   return (b < a) ? b : a;
 }
 
+unsigned int bigger( unsigned int a, unsigned int b){
+  return (b > a) ? b : a;
+}
+
 #include "CommandLine.h"
 
 // ****** writeAddress *****
 void writeAddress(unsigned int address, byte dataByte){
-  PORTC = highByte(address) | 0xF8;      //Set port C to the high byte of requested RAM address
-  PORTA = lowByte(address);       //Set Port A to the low byte of the requested RAM address
-
   #ifdef _DEBUG_
-    Serial.printf("Writing Address: 0x%04X: Data: 0x%02X\r\n", address, dataByte);
+    serialPrintf_P(PSTR("Writing Address: 0x%04X: Data: 0x%02X\r\n"), address, dataByte);
   #endif
 
-  DDRB_Output;        // all 1's is output for Atmega1284 PortB to write to IDC-7132 RAM
-  PORTB = dataByte;   // put the data bits on the data output
-  
-  RWL_LOW;  //set RW Left to low for writing to RAM digitalWrite(RWL_, LOW)
-  CEL_LOW;  //enable the memory chip digitalWrite(CEL_, LOW) 
-            //Busy signal is activated low only when the other side is in the same RAM location and CE has gone low
-  //write memory cycle is 6580ns 6.58us with this wait check
-  while (digitalRead(BUSY_) == LOW){ // 15 is PIN_PD7 in arduino assignment 
-    Serial.printf("> RAM BUSY_\r\n");
-  } // Wait if the dual port Memory is busy
-
-  CEL_HIGH; //digitalWrite(CEL_, HIGH)  // CEL_ goes high before RWL_ this lets Data stay valid on rising edge of CEL_
-  RWL_HIGH; //digitalWrite(RWL_, HIGH)
-  
-  DDRB_Input;         // set Atmega1284 Port B back to high inpeadence input all 0's
+  byte routine = routineBegin(ROUTINE_WRITE);
+  ramAccess<RAM_SHADOW, RAM_WRITE>(address, dataByte);
+  routineEnd(routine);
 }
 
 // ****** readAddress *****
 byte readAddress(unsigned int address){
-
-  PORTC = highByte(address) | 0xF8;      //Set port C to the high byte of requested RAM address
-  PORTA = lowByte(address);       //Set Port A to the low byte of the requested RAM address
-
-//  OEL_LOW;  //Set Output enable Left to low for outputing from RAM
-//  CEL_LOW;  //Chip Enable Left to low for reading from RAM
-  CEL_OEL_LOW; //Try a combined bit definition in a single instruction
-  __asm__ __volatile__ ("nop\n\t");   // take a nap.. a short nap 62.5 nanoseconds
-  __asm__ __volatile__ ("nop\n\t");   // take a nap.. a short nap 62.5 nanoseconds
-
-//  332ns with one delay
-//  264ns without the delay
-
-//  while (digitalRead(BUSY_) == LOW){ // 15 is PIN_PD7 in arduino assignment 
-//    Serial.printf("> RAM BUSY_\r\n");
-//  } // Wait if the dual port Memory is busy
-  
-  byte dataByte = PINB;
-
-//  CEL_HIGH;       // deselect RAM chip
-//  OEL_HIGH;       // disable the output
-  CEL_OEL_HIGH; //Try a combined bit definition in a single instruction
+  byte routine = routineBegin(ROUTINE_READ);
+  byte dataByte = ramAccess<RAM_SHADOW, RAM_READ>(address);
+  routineEnd(routine);
 
   #ifdef _DEBUG_
-    Serial.printf("Reading Address: 0x%04X: Data: 0x%02X\r\n", address, dataByte);
+    serialPrintf_P(PSTR("Reading Address: 0x%04X: Data: 0x%02X\r\n"), address, dataByte);
   #endif
 
   return dataByte; 
@@ -252,6 +382,7 @@ byte readAddress(unsigned int address){
 //
 // if it works.. It would be good to recode the main program to incorperate the funciton rather the the 99$% duplicate code
 // 2023-02-01 Tim Gopaul
+// 2026-10-17 done, both sets of routines are now thin wrappers over the RamAccess.h templates
 //
 // PIN_PD3 will allow save and load of game rom on second dual port ram when the pinball 6800 is powered down
 
@@ -280,57 +411,23 @@ volatile byte gameRamBuffer[ramSize];   // This is an array to hold the contents
 
 // ****** gameWriteAddress *****
 void gameWriteAddress(unsigned int address, byte dataByte){
-  PORTC = highByte(address) | 0xF8;      //Set port C to the high byte of requested RAM address
-  PORTA = lowByte(address);       //Set Port A to the low byte of the requested RAM address
-
   #ifdef _DEBUG_
-    Serial.printf("Writing Game Address: 0x%04X: Data: 0x%02X\r\n", address, dataByte);
+    serialPrintf_P(PSTR("Writing Game Address: 0x%04X: Data: 0x%02X\r\n"), address, dataByte);
   #endif
 
-  DDRB_Output;        // all 1's is output for Atmega1284 PortB to write to IDC-7132 RAM
-  PORTB = dataByte;   // put the data bits on the data output
-  
-  RWL_LOW;  //set RW Left to low for writing to RAM digitalWrite(RWL_, LOW)
-  CEL2_LOW;  //enable the memory chip digitalWrite(CEL2_, LOW) 
-            //Busy signal is activated low only when the other side is in the same RAM location and CE has gone low
-  //write memory cycle is 6580ns 6.58us with this wait check
-  while (digitalRead(BUSY_) == LOW){ // 15 is PIN_PD7 in arduino assignment 
-    Serial.printf("> RAM BUSY_\r\n");
-  } // Wait if the dual port Memory is busy
-
-  CEL2_HIGH; //digitalWrite(CEL2_, HIGH)  // CEL2_ goes high before RWL_ this lets Data stay valid on rising edge of CEL2_
-  RWL_HIGH; //digitalWrite(RWL_, HIGH)
-  
-  DDRB_Input;         // set Atmega1284 Port B back to high inpeadence input all 0's
+  byte routine = routineBegin(ROUTINE_WRITE);
+  ramAccess<RAM_GAME, RAM_WRITE>(address, dataByte);
+  routineEnd(routine);
 }
 
 // ****** gameReadAddress *****
 byte gameReadAddress(unsigned int address){
-
-  PORTC = highByte(address) | 0xF8;      //Set port C to the high byte of requested RAM address
-  PORTA = lowByte(address);       //Set Port A to the low byte of the requested RAM address
-
-//  OEL_LOW;  //Set Output enable Left to low for outputing from RAM
-//  CEL2_LOW;  //Chip Enable Left to low for reading from RAM
-  CEL2_OEL_LOW; //Try a combined bit definition in a single instruction
-  __asm__ __volatile__ ("nop\n\t");   // take a nap.. a short nap 62.5 nanoseconds
-  __asm__ __volatile__ ("nop\n\t");   // take a nap.. a short nap 62.5 nanoseconds
-
-//  332ns with one delay
-//  264ns without the delay
-
-//  while (digitalRead(BUSY_) == LOW){ // 15 is PIN_PD7 in arduino assignment 
-//    Serial.printf("> RAM BUSY_\r\n");
-//  } // Wait if the dual port Memory is busy
-  
-  byte dataByte = PINB;
-
-//  CEL2_HIGH;       // deselect RAM chip
-//  OEL_HIGH;       // disable the output
-  CEL2_OEL_HIGH; //Try a combined bit definition in a single instruction
+  byte routine = routineBegin(ROUTINE_READ);
+  byte dataByte = ramAccess<RAM_GAME, RAM_READ>(address);
+  routineEnd(routine);
 
   #ifdef _DEBUG_
-    Serial.printf("Reading Address: 0x%04X: Data: 0x%02X\r\n", address, dataByte);
+    serialPrintf_P(PSTR("Reading Address: 0x%04X: Data: 0x%02X\r\n"), address, dataByte);
   #endif
 
   return dataByte; 
@@ -344,46 +441,23 @@ void gameDumpRange(unsigned int addrStart, unsigned int addrCount){
 
   unsigned int addrEnd = smaller((addrStart + addrCount), ramSize);     //bounds check on gameRamBuffer index 
 
-  if ((addrStart % 16) != 0) Serial.printf("0x%04X: ", addrStart);
+  if ((addrStart % 16) != 0) serialPrintf_P(PSTR("0x%04X: "), addrStart);
   for (unsigned int address = addrStart; address < addrEnd; address++) { 
 
-    if ((address % 16) == 0) Serial.printf("0x%04X: ", address);
-    Serial.printf("0x%02X ",gameRamBuffer[address]);
+    if ((address % 16) == 0) serialPrintf_P(PSTR("0x%04X: "), address);
+    serialPrintf_P(PSTR("0x%02X "),gameRamBuffer[address]);
     if (((address % 16) == 15) | (address == (addrEnd -1)))  Serial.println();
   }
 }
 
-// ***** refreshBuffer *****
+// ***** gameRefreshBuffer *****
 void gameRefreshBuffer(unsigned int addrStart, unsigned int addrCount){
 // this will fill the buffer first
 
   unsigned int addrEnd = smaller((addrStart + addrCount), ramSize);     //bounds check on gameRamBuffer index 
-
-// PORT C lower bits are used for Address.
-// PORT C upper bits are used for control.
-// Setting the PORT C address will always put HIGH into upper 5 bits of PORTC used for control.
-// This is ok because the control bits in Upper C go low after address is set.
-// Don't pull CE_ WE_ OE_ low unless it is in the loop with setting the address
-
-  for (unsigned int address = addrStart; address < addrEnd; address++) { 
-    PORTC = highByte(address) | 0xF8;      //Set port C to the high byte of requested RAM address - ) 0xF8 will set control bits high
-    PORTA = lowByte(address);       //Set Port A to the low byte of the requested RAM address
- 
-    CEL2_OEL_LOW;                        // two NOP in Assembly code give a memory read time of 312 ns
-    __asm__ __volatile__ ("nop\n\t");   // take a nap.. a short nap 62.5 nanoseconds
-    __asm__ __volatile__ ("nop\n\t");   // take a nap.. a short nap 62.5 nanoseconds    
-
-//  2023-01-26 checking busy signal also gives time for address and dta to settle befoe reading locked in on CEL going high edge
-//    while (digitalRead(BUSY_) == LOW){ // 15 is PIN_PD7 in arduino assignment 
-//      Serial.printf("> RAM BUSY_\r\n");
-//      } // Wait if the dual port Memory is busy
-    
-    byte dataByte = PINB;
-    CEL2_OEL_HIGH;             // deselect RAM chip as soon as read is done
-    gameRamBuffer[address] = dataByte;  // load it into the buffer array to do printing later
-
-  }
-  
+  byte routine = routineBegin(ROUTINE_REFRESH);
+  ramReadBurst<RAM_GAME>(addrStart, addrEnd, gameRamBuffer);
+  routineEnd(routine);
 }                 // void game refreshBuffer(unsigned int addrStart, unsigned int addrCount){
 
 // 2023-02-19 Tim Gopaul remove the GameDumpBuffer that accesses the live RAM
@@ -406,7 +480,7 @@ void gameSaveMemory(unsigned int addrStart, unsigned int addrCount){
   int address = addrStart;
   int bytesThisLine;
   
-  Serial.printf("\n> Save Memory: 0x%04X: To Address: 0x%04X: \n", addrStart, addrEnd -1);
+  serialPrintf_P(PSTR("\n> Save Memory: 0x%04X: To Address: 0x%04X: \n"), addrStart, addrEnd -1);
   
   while (bytesToSave > 0) {
  
@@ -418,90 +492,43 @@ void gameSaveMemory(unsigned int addrStart, unsigned int addrCount){
     int chksum = bytesThisLine + highByte(address) + lowByte(address) + recordType;
     chksum &= 0xFF;
     int linePos = 0;  // initiallize line position left and count the hex output to MAXHEXLINE
-    Serial.printf(":%02X%04X%02X", bytesThisLine, address, recordType); 
+    serialPrintf_P(PSTR(":%02X%04X%02X"), bytesThisLine, address, recordType); 
     while (linePos < bytesThisLine) {
-      Serial.printf("%02X", gameRamBuffer[address]);
+      serialPrintf_P(PSTR("%02X"), gameRamBuffer[address]);
       chksum += gameRamBuffer[address] & 0xFF; 
       linePos+=1;
       address+=1;
     }
-    Serial.printf("%02X\n", (~chksum+1)& 0xFF);
+    serialPrintf_P(PSTR("%02X\n"), (~chksum+1)& 0xFF);
     bytesToSave -=bytesThisLine;
    }
 
   recordType = 0x01;            //   no address no databytes 01 - end-of-file record
-  Serial.printf(":00000001FF\n");  /* end of file marker */
+  serialPrintf_P(PSTR(":00000001FF\n"));  /* end of file marker */
 
 }
 
 // ***** fillRange *****
 void fillRange(unsigned int addrStart, unsigned int addrCount, byte dataByte){
-  //configure to write to RAM
-  DDRB_Output;        // all 1's is output for Atmega1284 PortB to write to IDC-7132 RAM
-//  RWL_LOW;            //this is a bulk write so keep RWL_ low using CEL_ to trigger write
 // 2023-02-06 Tim Gopaul Holding a control signal low can't be done now that Address setting always puts control lines high in PORTC
 // Put the RWL_LOW inside the loop after the address is set
 
-  PORTB = dataByte;                                         // filling the range with the same byte. set it out side of loop once
   unsigned int addrEnd = smaller((addrStart + addrCount), ramSize);                            //bounds check on ramBuffer index  
-  for (unsigned int address = addrStart; address < addrEnd; address++) { 
-    PORTC = highByte(address) | 0xF8;      //Set port C to the high byte of requested RAM address
-    PORTA = lowByte(address);       //Set Port A to the low byte of the requested RAM address
+  byte routine = routineBegin(ROUTINE_FILL);
+  ramFillBurst<RAM_SHADOW>(addrStart, addrEnd, dataByte, false);
+  routineEnd(routine);
 
-    #ifdef _DEBUG_
-    Serial.printf("Reading Address: 0x%04X: Data: 0x%02X\r\n", address, dataByte);
-    #endif
-
-    RWL_LOW;  //There will be a 1/16M delay between RWL_LOW and CEL_LOW this is minimum and is 62.5nano seconds on ATmega1284
-    CEL_LOW;
-
-    while (digitalRead(BUSY_) == LOW){ // 15 is PIN_PD7 in arduino assignment 
-      Serial.printf("> RAM BUSY_\r\n");
-    } // Wait if the dual port Memory is busy
-
-    CEL_HIGH;
-    RWL_HIGH;  //There will be a 1/16M delay between RWL_LOW and CEL_LOW this is minimum and is 62.5nano seconds on ATmega1284
-            
-  } //loop back for next write
-     
-  DDRB_Input;           // set Atmega1284 Port B back to high inpeadence input all 0's 
-  Serial.printf("> fillRange addrStart 0x%04X, addrCount 0x%04X, data 0x%02X\n", addrStart, addrCount, dataByte);
+  serialPrintf_P(PSTR("> fillRange addrStart 0x%04X, addrCount 0x%04X, data 0x%02X\n"), addrStart, addrCount, dataByte);
 } //fillRange
 
 // ****** fillRandomRange *****
 // this function receives a random databyte but needs to make its own for the fill
 void fillRandomRange(unsigned int addrStart, unsigned int addrCount ){
 
-unsigned int addrEnd = smaller((addrStart + addrCount), ramSize);     //bounds check on ramBuffer index 
-  //configure to write to RAM
-  DDRB_Output;    // all 1's is output for Atmega1284 PortB to write to IDC-7132 RAM
-
-  for (unsigned int address = addrStart; address < addrEnd; address++) { 
-
-    #ifdef _DEBUG_
-    Serial.printf("Reading Address: 0x%04X: Data: 0x%02X\r\n", address, dataByte);
-    #endif    
-    
-    PORTC = highByte(address) | 0xF8;      //Set port C to the high byte of requested RAM address
-    PORTA = lowByte(address);       //Set Port A to the low byte of the requested RAM address
-    
-    byte dataByte = (byte)random(0x100);
-    PORTB = dataByte;
-
-    RWL_LOW;        //try write low per byte rather than bulk
-    CEL_LOW;
-
-    while (digitalRead(BUSY_) == LOW){ // 15 is PIN_PD7 in arduino assignment 
-      Serial.printf("> RAM BUSY_\r\n");
-    } // Wait if the dual port Memory is busy
-    
-    CEL_HIGH;
-    RWL_HIGH;
-
-    } //go back for next address write
-    
-  DDRB_Input;        // set Atmega1284 Port B back to high inpeadence input all 0's 
-
+  unsigned int addrEnd = smaller((addrStart + addrCount), ramSize);     //bounds check on ramBuffer index 
+  byte routine = routineBegin(ROUTINE_FILL);
+  ramFillBurst<RAM_SHADOW>(addrStart, addrEnd, 0, true);
+  routineEnd(routine);
 }
 
 // ***** dumpRange *****
@@ -512,48 +539,617 @@ void dumpRange(unsigned int addrStart, unsigned int addrCount){
 
   unsigned int addrEnd = smaller((addrStart + addrCount), ramSize);     //bounds check on ramBuffer index 
 
-  if ((addrStart % 16) != 0) Serial.printf("0x%04X: ", addrStart);
+  if ((addrStart % 16) != 0) serialPrintf_P(PSTR("0x%04X: "), addrStart);
   for (unsigned int address = addrStart; address < addrEnd; address++) { 
 
-    if ((address % 16) == 0) Serial.printf("0x%04X: ", address);
-    Serial.printf("0x%02X ",ramBuffer[address]);
+    if ((address % 16) == 0) serialPrintf_P(PSTR("0x%04X: "), address);
+    serialPrintf_P(PSTR("0x%02X "),ramBuffer[address]);
     if (((address % 16) == 15) | (address == (addrEnd -1)))  Serial.println();
   }
 }
 
+// ***** Binary frames *****
+// dump prints 5 characters per RAM byte, a binary frame sends the byte itself.
+// Frame layout on the Serial link:
+//   0xA5               FRAME_SYNC
+//   type               one byte, FRAME_TYPE_DUMP for bdump
+//   length             payload byte count, low byte then high byte
+//   payload            length bytes
+//   crc                CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) of type, length and payload, high byte first
+// The frame is written as it is built so no extra buffer is needed.
+
+uint16_t frameCrc;
+
+// ***** crc16Update *****
+uint16_t crc16Update(uint16_t crc, byte dataByte){
+  crc ^= (uint16_t)dataByte << 8;
+  for (byte bit = 0; bit < 8; bit++) {
+    if (crc & 0x8000) crc = (crc << 1) ^ 0x1021;
+    else crc = crc << 1;
+  }
+  return crc;
+}
+
+// ***** frameByte *****
+void frameByte(byte dataByte){
+  Serial.write(dataByte);
+  frameCrc = crc16Update(frameCrc, dataByte);
+}
+
+// ***** frameBegin *****
+void frameBegin(byte frameType, unsigned int payloadLength){
+  Serial.write(FRAME_SYNC);
+  frameCrc = 0xFFFF;
+  frameByte(frameType);
+  frameByte(lowByte(payloadLength));
+  frameByte(highByte(payloadLength));
+}
+
+// ***** frameEnd *****
+void frameEnd(){
+  uint16_t crc = frameCrc;       // frameCrc is done, send it high byte first
+  Serial.write(highByte(crc));
+  Serial.write(lowByte(crc));
+}
+
+// ***** rangeFrame *****
+// Send ramBuffer from addrStart as a dump style frame, the caller has already refreshed the range
+void rangeFrame(byte frameType, unsigned int addrStart, unsigned int addrCount){
+
+  unsigned int addrEnd = smaller((addrStart + addrCount), ramSize);     //bounds check on ramBuffer index 
+  unsigned int byteCount = (addrStart < addrEnd) ? (addrEnd - addrStart) : 0;  //still answer with an empty frame if out of range
+
+  frameBegin(frameType, byteCount + 2);
+  frameByte(highByte(addrStart));
+  frameByte(lowByte(addrStart));
+  for (unsigned int address = addrStart; address < addrEnd; address++) {
+    frameByte(ramBuffer[address]);
+  }
+  frameEnd();
+}
+
+// ***** bdumpRange *****
+// Same range as dumpRange but sent as one FRAME_TYPE_DUMP frame for the ESP32
+void bdumpRange(unsigned int addrStart, unsigned int addrCount){
+
+  byte routine = routineBegin(ROUTINE_BDUMP);
+  refreshBuffer(addrStart, addrCount);
+  routineEnd(routine);
+  rangeFrame(FRAME_TYPE_DUMP, addrStart, addrCount);
+}
+
+// ***** Sample frames *****
+// Ranges that are read back to back and sent together in one FRAME_TYPE_SAMPLE frame, so the ESP32
+// never combines a game state from one moment with scores from another.
+// The id comes from the mdump command so the ESP32 can match replies to requests, watch uses WATCH_SAMPLE_ID.
+
+//
+// The 6800 writes a 4 byte BCD score one byte at a time, so a read can catch it half way.
+// With validate on, sampleRead reads the ranges a second time and retries until both reads match
+// and every byte in the BCD ranges has two digits 0-9. Samples that never settle are flagged,
+// watch holds them back and mdump sends them without SAMPLE_VALIDATED.
+
+bool validateOn = false;
+byte validateBcdRanges = 0;
+unsigned int validateBcdStart[VALIDATE_MAX_BCD];
+unsigned int validateBcdCount[VALIDATE_MAX_BCD];
+unsigned long validateSamples = 0;      // samples read with validate on
+unsigned long validateRetries = 0;      // extra reads
+unsigned long validateTorn = 0;         // second read differed from the first
+unsigned long validateBadBcd = 0;       // reads that matched but held a nibble above 9
+unsigned long validateFailed = 0;       // samples still bad after VALIDATE_MAX_TRIES reads
+
+// ***** bcdValid *****
+bool bcdValid(unsigned int addrStart, unsigned int addrCount){
+  for (byte i = 0; i < validateBcdRanges; i++) {
+    unsigned int bcdStart = bigger(addrStart, validateBcdStart[i]);
+    unsigned int bcdEnd = smaller(addrStart + addrCount, validateBcdStart[i] + validateBcdCount[i]);
+    for (unsigned int address = bcdStart; address < bcdEnd; address++) {
+      byte dataByte = ramBuffer[address];
+      if (((dataByte & 0x0F) > 9) || ((dataByte >> 4) > 9)) return false;
+    }
+  }
+  return true;
+}
+
+// ***** sampleRead *****
+// refresh every range in one pass, clamps the counts to the RAM so the frame matches what was read.
+// Returns true when the sample is validated, always false with validate off.
+bool sampleRead(byte routine, byte ranges, unsigned int *addrStarts, unsigned int *addrCounts){
+  bool validated = false;
+  byte previous = routineBegin(routine);
+
+  for (byte i = 0; i < ranges; i++) {
+    if (addrStarts[i] >= ramSize) addrCounts[i] = 0;
+    addrCounts[i] = smaller(addrCounts[i], ramSize - addrStarts[i]);
+  }
+
+  for (byte tries = 0; tries < VALIDATE_MAX_TRIES; tries++) {
+    for (byte i = 0; i < ranges; i++) refreshBuffer(addrStarts[i], addrCounts[i]);
+    if (!validateOn) break;
+
+    if (tries > 0) validateRetries++;
+    bool torn = false;
+    bool badBcd = false;
+    for (byte i = 0; i < ranges; i++) {
+      if (!ramVerifyBurst<RAM_SHADOW>(addrStarts[i], addrStarts[i] + addrCounts[i], ramBuffer)) torn = true;
+      else if (!bcdValid(addrStarts[i], addrCounts[i])) badBcd = true;
+    }
+    if (torn) validateTorn++;
+    else if (badBcd) validateBadBcd++;
+    else {
+      validated = true;
+      break;
+    }
+  }
+
+  if (validateOn) {
+    validateSamples++;
+    if (!validated) validateFailed++;
+  }
+  routineEnd(previous);
+  return validated;
+}
+
+// ***** sampleFrame *****
+// send ranges already in ramBuffer, call sampleRead first
+void sampleFrame(byte id, byte flags, byte ranges, unsigned int *addrStarts, unsigned int *addrCounts){
+  unsigned int payloadLength = 3;
+  for (byte i = 0; i < ranges; i++) payloadLength += 4 + addrCounts[i];
+
+  frameBegin(FRAME_TYPE_SAMPLE, payloadLength);
+  frameByte(id);
+  frameByte(flags);
+  frameByte(ranges);
+  for (byte i = 0; i < ranges; i++) {
+    frameByte(highByte(addrStarts[i]));
+    frameByte(lowByte(addrStarts[i]));
+    frameByte(lowByte(addrCounts[i]));
+    frameByte(highByte(addrCounts[i]));
+    for (unsigned int offset = 0; offset < addrCounts[i]; offset++) {
+      frameByte(ramBuffer[addrStarts[i] + offset]);
+    }
+  }
+  frameEnd();
+}
+
+// ***** mdumpRanges *****
+void mdumpRanges(byte id, byte ranges, unsigned int *addrStarts, unsigned int *addrCounts){
+  bool validated = sampleRead(ROUTINE_MDUMP, ranges, addrStarts, addrCounts);
+  sampleFrame(id, validated ? SAMPLE_VALIDATED : 0, ranges, addrStarts, addrCounts);
+}
+
+// ***** Watch *****
+// The ESP32 subscribes once with watch <addr> <count> [<addr> <count>...] instead of polling with bdump.
+// loop() calls watchPoll() which re-reads the ranges every watchInterval ms and, when any watched
+// byte changed, pushes all of them in one FRAME_TYPE_SAMPLE frame.
+// The first poll after subscribing always pushes so the ESP32 starts from a full picture.
+
+unsigned int watchStart[WATCH_MAX_RANGES];
+unsigned int watchCount[WATCH_MAX_RANGES];
+byte watchRanges = 0;                     // 0 when nothing is watched
+byte watchBuffer[WATCH_BUFFER_SIZE];      // last values pushed, ranges packed one after the other
+bool watchPushAll = false;
+unsigned long watchTimer;
+unsigned int watchInterval = WATCH_INTERVAL_MS;  // every poll contends with the 6800 for the shadow RAM
+
+// ***** watchClear *****
+void watchClear(){
+  watchRanges = 0;
+}
+
+// ***** watchAdd *****
+bool watchAdd(unsigned int addrStart, unsigned int addrCount){
+  unsigned int used = 0;
+  for (byte i = 0; i < watchRanges; i++) used += watchCount[i];
+
+  if (watchRanges >= WATCH_MAX_RANGES) return false;
+  if (addrStart >= ramSize || addrCount == 0) return false;
+  addrCount = smaller(addrCount, ramSize - addrStart);
+  if (used + addrCount > WATCH_BUFFER_SIZE) return false;
+
+  watchStart[watchRanges] = addrStart;
+  watchCount[watchRanges] = addrCount;
+  watchRanges++;
+  watchPushAll = true;
+  return true;
+}
+
+// ***** watchPoll *****
+void watchPoll(){
+  if (watchRanges == 0) return;
+  if (millis() - watchTimer < watchInterval) return;   // overflow safe
+  watchTimer = millis();
+
+  bool validated = sampleRead(ROUTINE_WATCH, watchRanges, watchStart, watchCount);
+  if (validateOn && !validated) return;   // try again next poll rather than push a torn score
+
+  byte *lastSent = watchBuffer;
+  bool changed = watchPushAll;
+  for (byte i = 0; i < watchRanges; i++) {
+    for (unsigned int offset = 0; offset < watchCount[i]; offset++) {
+      byte dataByte = ramBuffer[watchStart[i] + offset];
+      if (lastSent[offset] != dataByte) {
+        lastSent[offset] = dataByte;
+        changed = true;
+      }
+    }
+    lastSent += watchCount[i];
+  }
+
+  if (changed) sampleFrame(WATCH_SAMPLE_ID, validated ? SAMPLE_VALIDATED : 0, watchRanges, watchStart, watchCount);
+  watchPushAll = false;
+}
+
+// ***** Diff *****
+// diff <addr> <count> [keyframeEvery] [intervalMs] keeps the previous read of the range in diffBuffer.
+// Each diff frame reads the range again and sends only the bytes that changed as
+// (address, length, bytes) records in a FRAME_TYPE_DELTA frame, then updates diffBuffer.
+// The first frame, and every keyframeEvery frames after that, is a full FRAME_TYPE_KEYFRAME.
+// With intervalMs loop() keeps streaming, empty deltas are skipped so an idle game sends nothing.
+// Each frame carries a sequence byte so a receiver that misses one knows to wait for the next keyframe.
+// diffBuffer is the flight recorder's flightLast as well, so diff is refused while flight is on.
+
+byte snapshotBuffer[ramSize];      // diffBuffer or flightLast, whichever of diff and flight is running
+byte * const diffBuffer = snapshotBuffer;   // previous snapshot, indexed by RAM address like ramBuffer
+extern byte flightState;           // Flight recorder below
+bool diffGame = false;             // true for gameDiff, reads the live game RAM through gameRefreshBuffer
+bool diffValid = false;            // false until a keyframe has been sent for the current range
+unsigned int diffStart = 0;
+unsigned int diffCount = 0;
+unsigned int diffKeyframeEvery = 0;   // 0 keyframe only when the range changes
+unsigned int diffSinceKeyframe = 0;
+unsigned int diffIntervalMs = 0;      // 0 is a one shot diff
+unsigned long diffTimer;
+byte diffSequence = 0;
+
+// ***** diffNextRun *****
+// Find the next run of changed bytes at or after address, returns false when the rest of the range is unchanged
+bool diffNextRun(const byte *current, unsigned int &address, unsigned int addrEnd, unsigned int &runStart, byte &runLength){
+
+  while ((address < addrEnd) && (diffBuffer[address] == current[address])) address++;
+  if (address >= addrEnd) return false;
+
+  runStart = address;
+  unsigned int runEnd = address + 1;          // one past the last changed byte
+  for (unsigned int scan = runEnd; (scan < addrEnd) && (scan - runStart < 0xFF); scan++) {
+    if (diffBuffer[scan] != current[scan]) runEnd = scan + 1;
+    else if (scan - runEnd >= DIFF_MERGE_GAP) break;
+  }
+  runLength = runEnd - runStart;
+  address = runEnd;
+  return true;
+}
+
+// ***** diffSetup *****
+// false while the flight recorder holds snapshotBuffer
+bool diffSetup(bool game, unsigned int addrStart, unsigned int addrCount, unsigned int keyframeEvery, unsigned int intervalMs){
+  if (flightState != FLIGHT_OFF) return false;
+
+  unsigned int addrEnd = smaller((addrStart + addrCount), ramSize);     //bounds check on diffBuffer index 
+  addrCount = (addrStart < addrEnd) ? (addrEnd - addrStart) : 0;
+
+  if ((game != diffGame) || (addrStart != diffStart) || (addrCount != diffCount)) diffValid = false;
+  diffGame = game;
+  diffStart = addrStart;
+  diffCount = addrCount;
+  diffKeyframeEvery = keyframeEvery;
+  diffIntervalMs = intervalMs;
+  diffTimer = millis();
+  return true;
+}
+
+// ***** diffStop *****
+void diffStop(){
+  diffIntervalMs = 0;
+}
+
+// ***** diffFrame *****
+void diffFrame(bool sendEmpty){
+  const byte *current;
+  unsigned int addrEnd = diffStart + diffCount;
+
+  byte routine = routineBegin(ROUTINE_DIFF);
+  if (diffGame) {
+    gameRefreshBuffer(diffStart, diffCount);
+    current = (const byte *)gameRamBuffer;
+  }
+  else {
+    refreshBuffer(diffStart, diffCount);
+    current = (const byte *)ramBuffer;
+  }
+  routineEnd(routine);
+
+  if (!diffValid || ((diffKeyframeEvery != 0) && (diffSinceKeyframe >= diffKeyframeEvery))) {
+    frameBegin(FRAME_TYPE_KEYFRAME, diffCount + 3);
+    frameByte(diffSequence++);
+    frameByte(highByte(diffStart));
+    frameByte(lowByte(diffStart));
+    for (unsigned int address = diffStart; address < addrEnd; address++) {
+      frameByte(current[address]);
+      diffBuffer[address] = current[address];
+    }
+    frameEnd();
+    diffValid = true;
+    diffSinceKeyframe = 0;
+    return;
+  }
+
+  // first pass sizes the frame, the second sends the records and moves diffBuffer forward
+  unsigned int address = diffStart;
+  unsigned int runStart;
+  byte runLength;
+  unsigned int payloadLength = 1;
+  while (diffNextRun(current, address, addrEnd, runStart, runLength)) payloadLength += 3 + runLength;
+
+  if ((payloadLength == 1) && !sendEmpty) return;
+
+  frameBegin(FRAME_TYPE_DELTA, payloadLength);
+  frameByte(diffSequence++);
+  address = diffStart;
+  while (diffNextRun(current, address, addrEnd, runStart, runLength)) {
+    frameByte(highByte(runStart));
+    frameByte(lowByte(runStart));
+    frameByte(runLength);
+    for (unsigned int i = runStart; i < runStart + runLength; i++) {
+      frameByte(current[i]);
+      diffBuffer[i] = current[i];
+    }
+  }
+  frameEnd();
+  diffSinceKeyframe++;
+}
+
+// ***** diffPoll *****
+void diffPoll(){
+  if (diffIntervalMs == 0) return;
+  if (millis() - diffTimer < diffIntervalMs) return;   // overflow safe
+  diffTimer = millis();
+  diffFrame(false);
+}
+
+// ***** Flight recorder *****
+// flight on keeps a rolling history of the shadow RAM, which sees every 6800 write, so a crash can be
+// looked at afterwards without a logic analyser on site. Every flightIntervalMs loop() reads the 2K and
+// the runs of bytes that changed go into flightLog as undo records holding the old values.
+// flightLast is always the newest picture and walking the log back from it gives the RAM at any older
+// frame, so when the log is full the oldest frames are just dropped.
+// flightLast is diffBuffer's snapshotBuffer, flight on is refused while a diff stream runs and takes the
+// buffer from a one shot diff, whose next frame is then a keyframe.
+// A live RAM BUSY fault lets FLIGHT_POST_FRAMES more reads in and then freezes the recorder until the next
+// flight on. The live RAM itself is never read here, reading it is what hands the 6800 a BUSY.
+//
+// flightLog frame: frame length low, high, millis (4 bytes, low first),
+//                  then records of address high, address low, count and count old bytes
+//
+// flightdump bin sends one FRAME_TYPE_FLIGHT frame: state, fault seen, fault address high, low,
+// fault millis (4 bytes, low first), frame count low, high, flightLast, then the log oldest frame first.
+
+const char *flightStateNames[] = { "off", "recording", "frozen" };
+
+byte * const flightLast = snapshotBuffer;
+byte flightLog[FLIGHT_LOG_SIZE];
+unsigned int flightHead = 0;          // offset the next frame goes to
+unsigned int flightTail = 0;          // offset of the oldest frame
+unsigned int flightUsed = 0;
+unsigned int flightFrames = 0;
+byte flightState = FLIGHT_OFF;
+unsigned int flightIntervalMs = FLIGHT_INTERVAL_MS;
+unsigned long flightTimer;
+byte flightPostFrames;
+unsigned long flightDropped = 0;      // frames dropped off the old end of the log
+unsigned long flightOversize = 0;     // changes too big for the log, history restarted from that read
+volatile bool flightFaultSeen = false;
+volatile unsigned int flightFaultAddress;
+volatile unsigned long flightFaultMillis;
+
+// ***** flightFault *****
+// called from BusyFaultWarning only
+void flightFault(unsigned int address){
+  if ((flightState != FLIGHT_RECORDING) || flightFaultSeen) return;
+  flightFaultAddress = address;
+  flightFaultMillis = millis();
+  flightFaultSeen = true;
+}
+
+// ***** flightByte *****
+byte flightByte(unsigned int offset){
+  return flightLog[offset & (FLIGHT_LOG_SIZE - 1)];
+}
+
+// ***** flightPut *****
+void flightPut(byte dataByte){
+  flightLog[flightHead] = dataByte;
+  flightHead = (flightHead + 1) & (FLIGHT_LOG_SIZE - 1);
+  flightUsed++;
+}
+
+// ***** flightFrameLength *****
+unsigned int flightFrameLength(unsigned int offset){
+  return flightByte(offset) | (flightByte(offset + 1) << 8);
+}
+
+// ***** flightClear *****
+void flightClear(){
+  flightHead = flightTail = flightUsed = flightFrames = 0;
+}
+
+// ***** flightNextRun *****
+// next run of bytes that differ between ramBuffer and flightLast, at most 255 long for the count byte
+bool flightNextRun(unsigned int &address, unsigned int &runStart, byte &runLength){
+  while ((address < ramSize) && (ramBuffer[address] == flightLast[address])) address++;
+  if (address >= ramSize) return false;
+  runStart = address;
+  while ((address < ramSize) && (address - runStart < 255) && (ramBuffer[address] != flightLast[address])) address++;
+  runLength = address - runStart;
+  return true;
+}
+
+// ***** flightCapture *****
+void flightCapture(){
+  unsigned int address = 0;
+  unsigned int runStart;
+  byte runLength;
+  unsigned int frameLength = FLIGHT_HEADER;
+
+  byte routine = routineBegin(ROUTINE_FLIGHT);
+  refreshBuffer(0, ramSize);
+  routineEnd(routine);
+
+  while (flightNextRun(address, runStart, runLength)) frameLength += 3 + runLength;
+  if (frameLength == FLIGHT_HEADER) return;          // nothing changed, no frame
+
+  if (frameLength > FLIGHT_LOG_SIZE) {
+    ++flightOversize;
+    flightClear();
+    for (address = 0; address < ramSize; address++) flightLast[address] = ramBuffer[address];
+    return;
+  }
+
+  while (flightUsed + frameLength > FLIGHT_LOG_SIZE) {
+    unsigned int oldest = flightFrameLength(flightTail);
+    flightTail = (flightTail + oldest) & (FLIGHT_LOG_SIZE - 1);
+    flightUsed -= oldest;
+    flightFrames--;
+    ++flightDropped;
+  }
+
+  unsigned long now = millis();
+  flightPut(lowByte(frameLength));
+  flightPut(highByte(frameLength));
+  for (byte i = 0; i < 4; i++) flightPut(now >> (8 * i));
+
+  address = 0;
+  while (flightNextRun(address, runStart, runLength)) {
+    flightPut(highByte(runStart));
+    flightPut(lowByte(runStart));
+    flightPut(runLength);
+    for (unsigned int i = runStart; i < runStart + runLength; i++) {
+      flightPut(flightLast[i]);
+      flightLast[i] = ramBuffer[i];
+    }
+  }
+  flightFrames++;
+}
+
+// ***** flightStart *****
+// false while a diff stream uses snapshotBuffer
+bool flightStart(unsigned int intervalMs){
+  if (diffIntervalMs != 0) return false;
+  diffValid = false;
+
+  byte routine = routineBegin(ROUTINE_FLIGHT);
+  refreshBuffer(0, ramSize);
+  routineEnd(routine);
+  for (unsigned int address = 0; address < ramSize; address++) flightLast[address] = ramBuffer[address];
+
+  flightClear();
+  flightIntervalMs = intervalMs;
+  flightPostFrames = FLIGHT_POST_FRAMES;
+  flightFaultSeen = false;
+  flightTimer = millis();
+  flightState = FLIGHT_RECORDING;
+  return true;
+}
+
+// ***** flightStop *****
+void flightStop(){
+  flightState = FLIGHT_OFF;
+}
+
+// ***** flightPoll *****
+void flightPoll(){
+  if (flightState != FLIGHT_RECORDING) return;
+  if (millis() - flightTimer < flightIntervalMs) return;   // overflow safe
+  flightTimer = millis();
+  flightCapture();
+
+  if (!flightFaultSeen) return;
+  if (flightPostFrames > 0) {
+    flightPostFrames--;
+    return;
+  }
+  flightState = FLIGHT_FROZEN;
+  serialPrintf_P(PSTR("\n> Flight recorder frozen, BUSY at 0x%04X, %u frames kept\n"), flightFaultAddress, flightFrames);
+}
+
+// ***** flightRewind *****
+// rebuild in ramBuffer the RAM as it was before the newest framesBack frames, newest frame undone first
+void flightRewind(unsigned int framesBack){
+  for (unsigned int address = 0; address < ramSize; address++) ramBuffer[address] = flightLast[address];
+  framesBack = smaller(framesBack, flightFrames);
+
+  for (unsigned int frame = flightFrames; frame > flightFrames - framesBack; frame--) {
+    unsigned int offset = flightTail;
+    for (unsigned int skip = 1; skip < frame; skip++) offset += flightFrameLength(offset);
+
+    unsigned int frameEnd = offset + flightFrameLength(offset);
+    offset += FLIGHT_HEADER;
+    while (offset < frameEnd) {
+      unsigned int runStart = (flightByte(offset) << 8) | flightByte(offset + 1);
+      byte runLength = flightByte(offset + 2);
+      offset += 3;
+      for (byte i = 0; i < runLength; i++) ramBuffer[runStart + i] = flightByte(offset++);
+    }
+  }
+}
+
+// ***** flightStatus *****
+void flightStatus(){
+  serialPrintf_P(PSTR("> Flight recorder %s, every %u ms, %u frames in %u bytes\n"),
+                flightStateNames[flightState], flightIntervalMs, flightFrames, flightUsed);
+  if (flightFrames > 0) {
+    unsigned long oldest = 0;
+    for (byte i = 0; i < 4; i++) oldest |= (unsigned long)flightByte(flightTail + 2 + i) << (8 * i);
+    serialPrintf_P(PSTR("> oldest frame %lu ms, now %lu ms\n"), oldest, millis());
+  }
+  serialPrintf_P(PSTR("> dropped %lu, oversize %lu\n"), flightDropped, flightOversize);
+  if (flightFaultSeen) serialPrintf_P(PSTR("> BUSY at 0x%04X, %lu ms\n"), flightFaultAddress, flightFaultMillis);
+}
+
+// ***** flightDumpBin *****
+void flightDumpBin(){
+  unsigned long faultMillis = flightFaultMillis;
+
+  frameBegin(FRAME_TYPE_FLIGHT, 10 + ramSize + flightUsed);
+  frameByte(flightState);
+  frameByte(flightFaultSeen);
+  frameByte(highByte(flightFaultAddress));
+  frameByte(lowByte(flightFaultAddress));
+  for (byte i = 0; i < 4; i++) frameByte(faultMillis >> (8 * i));
+  frameByte(lowByte(flightFrames));
+  frameByte(highByte(flightFrames));
+  for (unsigned int address = 0; address < ramSize; address++) frameByte(flightLast[address]);
+  for (unsigned int offset = 0; offset < flightUsed; offset++) frameByte(flightByte(flightTail + offset));
+  frameEnd();
+}
+
+// ***** flightDumpHex *****
+// Intel HEX of the whole RAM framesBack frames before the newest, load it with gameload on a bench machine
+void flightDumpHex(unsigned int framesBack){
+  flightRewind(framesBack);
+  serialPrintf_P(PSTR("\n> Flight recorder RAM %u frames back of %u\n"), smaller(framesBack, flightFrames), flightFrames);
+  hexWriteBuffer(ramBuffer, 0, ramSize);
+}
+
 // ***** refreshBuffer *****
 void refreshBuffer(unsigned int addrStart, unsigned int addrCount){
 // this will fill the buffer first
 
 #ifdef _DEBUG_
-  Serial.printf("> debug just called to refresh ramBuffer 0x%04X\n", (int)ramBuffer);
+  serialPrintf_P(PSTR("> debug just called to refresh ramBuffer 0x%04X\n"), (int)ramBuffer);
 #endif
 
   unsigned int addrEnd = smaller((addrStart + addrCount), ramSize);     //bounds check on ramBuffer index 
 
 // PORT C lower bits are used for Address.
 // PORT C upper bits are used for control.
-// Setting the PORT C address will always put HIGH into upper 5 bits of PORTC used for control.
-// This is ok because the control bits in Upper C go low after address is set.
+// ramReadBurst writes the whole of PORTC, address bits and control lines high, once per 256 byte page.
 // Don't pull CE_ WE_ OE_ low unless it is in the loop with setting the address
 
-  for (unsigned int address = addrStart; address < addrEnd; address++) { 
-    PORTC = highByte(address) | 0xF8;      //Set port C to the high byte of requested RAM address
-    PORTA = lowByte(address);       //Set Port A to the low byte of the requested RAM address
-
-    CEL_OEL_LOW;                            // two NOP in Assembly code give a memory read time of 312 ns
-    __asm__ __volatile__ ("nop\n\t");   // take a nap.. a short nap 62.5 nanoseconds
-    __asm__ __volatile__ ("nop\n\t");   // take a nap.. a short nap 62.5 nanoseconds    
-
-//  2023-01-26 checking busy signal also gives time for address and dta to settle befoe reading locked in on CEL going high edge
-//    while (digitalRead(BUSY_) == LOW){ // 15 is PIN_PD7 in arduino assignment 
-//      Serial.printf("> RAM BUSY_\r\n");
-//      } // Wait if the dual port Memory is busy
-    
-    byte dataByte = PINB;
-    CEL_OEL_HIGH;             // deselect RAM chip as soon as read is done
-    ramBuffer[address] = dataByte;  // load it into the buffer array to do printing later
-  }
+  byte routine = routineBegin(ROUTINE_REFRESH);
+  ramReadBurst<RAM_SHADOW>(addrStart, addrEnd, ramBuffer);
+  routineEnd(routine);
 }  // void refreshBuffer(unsigned int addrStart, unsigned int addrCount){
 
 
@@ -564,15 +1160,15 @@ void dumpBuffRange(unsigned int addrStart, unsigned int addrCount){
 
   unsigned int addrEnd = smaller((addrStart + addrCount), ramSize);     //bounds check on ramBuffer index 
 
-  Serial.printf("> Dump Buffer: 0x%04X: To Address Data: 0x%04X: \n", addrStart, addrEnd -1);
-  if ((addrStart % 16) != 0) Serial.printf("\n0x%04X: ", addrStart);
+  serialPrintf_P(PSTR("> Dump Buffer: 0x%04X: To Address Data: 0x%04X: \n"), addrStart, addrEnd -1);
+  if ((addrStart % 16) != 0) serialPrintf_P(PSTR("\n0x%04X: "), addrStart);
   for (unsigned int address = addrStart; address < addrEnd; address++) { 
   
-    if ((address % 16) == 0) Serial.printf("\n0x%04X: ", address);
-    Serial.printf("0x%02X ", ramBuffer[address]);
+    if ((address % 16) == 0) serialPrintf_P(PSTR("\n0x%04X: "), address);
+    serialPrintf_P(PSTR("0x%02X "), ramBuffer[address]);
 
     #ifdef _DEBUG_
-    Serial.printf("Reading Address: 0x%04X: Data: 0x%02X\n", address, ramBuffer[address]);
+    serialPrintf_P(PSTR("Reading Address: 0x%04X: Data: 0x%02X\n"), address, ramBuffer[address]);
     #endif
   }
   Serial.println();
@@ -580,22 +1176,22 @@ void dumpBuffRange(unsigned int addrStart, unsigned int addrCount){
 
 //Dump the buffer displaying contents as ASCII if printable
 
-  Serial.printf("> Dump Buffer ASCII: 0x%04X: To Address Data: 0x%04X: \n", addrStart, addrEnd -1);
+  serialPrintf_P(PSTR("> Dump Buffer ASCII: 0x%04X: To Address Data: 0x%04X: \n"), addrStart, addrEnd -1);
   Serial.println();
   
   //creat column headings from low address nibble
-  Serial.print("        "); //print some leading space
+  Serial.print(F("        ")); //print some leading space
   for (unsigned int i = 0; i <= 0x0f;i++)
-    Serial.printf( "%1X ",i);
+    serialPrintf_P(PSTR("%1X "),i);
   
-  if ((addrStart % 16) != 0) Serial.printf("\n0x%04X: ", addrStart);
+  if ((addrStart % 16) != 0) serialPrintf_P(PSTR("\n0x%04X: "), addrStart);
   for (unsigned int address = addrStart; address < addrEnd ; address++) { 
   
-    if ((address % 16) == 0) Serial.printf("\n0x%04X: ", address);
+    if ((address % 16) == 0) serialPrintf_P(PSTR("\n0x%04X: "), address);
     if (isPrintable(ramBuffer[address]))
-      Serial.printf("%c ", (char)ramBuffer[address]);
+      serialPrintf_P(PSTR("%c "), (char)ramBuffer[address]);
     else
-      Serial.printf("%c ", ' ');
+      serialPrintf_P(PSTR("%c "), ' ');
   }
   
   Serial.println();
@@ -657,8 +1253,16 @@ void saveMemory(unsigned int addrStart, unsigned int addrCount){
   // copy the RAM memory to a buffer array before processing output
   // Global array is used ramBuffer[2048] 
 
-  int bytesToSave = addrCount;                //initialize to the number of bytes to save and decrement for each record / line
   unsigned int addrEnd = smaller((addrStart + addrCount), ramSize);
+  serialPrintf_P(PSTR("\n> Save Memory: 0x%04X: To Address: 0x%04X: \n"), addrStart, addrEnd -1);
+  hexWriteBuffer(ramBuffer, addrStart, addrCount);
+}
+
+// ***** hexWriteBuffer *****
+// Intel HEX data records for buffer[addrStart] on, then the end of file record
+void hexWriteBuffer(volatile byte *buffer, unsigned int addrStart, unsigned int addrCount){
+
+  int bytesToSave = addrCount;                //initialize to the number of bytes to save and decrement for each record / line
   int recordType = 0x00;                      //Record Type
                                               // tt is the field that represents the HEX record type, which may be one of the following:
                                               // 00 - data record
@@ -666,8 +1270,6 @@ void saveMemory(unsigned int addrStart, unsigned int addrCount){
   int address = addrStart;
   int bytesThisLine;
   
-  Serial.printf("\n> Save Memory: 0x%04X: To Address: 0x%04X: \n", addrStart, addrEnd -1);
-  
   while (bytesToSave > 0) {
  
     if (bytesToSave > MAXHEXLINE)
@@ -678,25 +1280,25 @@ void saveMemory(unsigned int addrStart, unsigned int addrCount){
     int chksum = bytesThisLine + highByte(address) + lowByte(address) + recordType;
     chksum &= 0xFF;
     int linePos = 0;  // initiallize line position left and count the hex output to MAXHEXLINE
-    Serial.printf(":%02X%04X%02X", bytesThisLine, address, recordType); 
+    serialPrintf_P(PSTR(":%02X%04X%02X"), bytesThisLine, address, recordType); 
     while (linePos < bytesThisLine) {
-      Serial.printf("%02X", ramBuffer[address]);
-      chksum += ramBuffer[address] & 0xFF; 
+      serialPrintf_P(PSTR("%02X"), buffer[address]);
+      chksum += buffer[address] & 0xFF; 
       linePos+=1;
       address+=1;
     }
-    Serial.printf("%02X\n", (~chksum+1)& 0xFF);
+    serialPrintf_P(PSTR("%02X\n"), (~chksum+1)& 0xFF);
     bytesToSave -=bytesThisLine;
    }
 
   recordType = 0x01;            //   no address no databytes 01 - end-of-file record
-  Serial.printf(":00000001FF\n");  /* end of file marker */
+  serialPrintf_P(PSTR(":00000001FF\n"));  /* end of file marker */
 
 }
 
 // ***** loadMemory *****
 void loadMemory(){
-  Serial.printf("> Waiting for Intel Hex input records or end of file record :00000001FF\n");
+  serialPrintf_P(PSTR("> Waiting for Intel Hex input records or end of file record :00000001FF\n"));
   inputMode = DataMode;  
   // This flips to DataMode so that main loop will dispatch input to build Intel Hex input line
   // once in DataMode the main loop will add characters to a buffer line until enter is pressed Linefeed.
@@ -708,7 +1310,7 @@ void loadMemory(){
 
 // ***** gameLoadMemory *****
 void gameLoadMemory(){
-  Serial.printf("> Waiting for Intel Hex input records or end of file record :00000001FF\n");
+  serialPrintf_P(PSTR("> Waiting for Intel Hex input records or end of file record :00000001FF\n"));
   inputMode = gameDataMode;  
   // This flips to DataMode so that main loop will dispatch input to build Intel Hex input line
   // once in DataMode the main loop will add characters to a buffer line until enter is pressed Linefeed.
@@ -718,6 +1320,336 @@ void gameLoadMemory(){
   // .. add CTRL-C and esc as ways to terminate the input
 }
 
+// ***** Block loader *****
+// bload <addr> <count> replaces line at a time Intel HEX for bulk restores. The host sends
+// FRAME_TYPE_BLOCK frames, same layout and CRC as the frames we send, of up to BLOCK_MAX_DATA bytes
+// in address order. Each block is written with one burst, read back to verify and answered with a
+// FRAME_TYPE_ACK frame carrying the status and the next address wanted. The host waits for that
+// answer before the next block, the first answer says we are ready.
+// The whole count loaded, a FRAME_TYPE_STOP frame, or BLOCK_TIMEOUT_MS of silence returns to command input.
+// Stop is a frame rather than a key because any byte value can turn up between blocks, a NAKed host
+// may be half way through sending the next one.
+// tools/blockload.py sends a dumps/*.txt or Intel HEX file this way.
+
+#define BLOCK_HUNT 0
+#define BLOCK_TYPE 1
+#define BLOCK_LENGTH_LOW 2
+#define BLOCK_LENGTH_HIGH 3
+#define BLOCK_PAYLOAD 4
+#define BLOCK_CRC_HIGH 5
+#define BLOCK_CRC_LOW 6
+
+byte blockPayload[BLOCK_MAX_DATA + 2];
+byte blockState;
+byte blockType;
+unsigned int blockLength;
+unsigned int blockIndex;
+uint16_t blockCrc;
+uint16_t blockReceivedCrc;
+unsigned int blockNext;               // address the next block must start at
+unsigned int blockEnd;
+unsigned long blockLastByte;
+unsigned int blockNaks;
+
+// ***** blockAck *****
+void blockAck(byte status){
+  frameBegin(FRAME_TYPE_ACK, 3);
+  frameByte(status);
+  frameByte(highByte(blockNext));
+  frameByte(lowByte(blockNext));
+  frameEnd();
+  if (status != BLOCK_OK) blockNaks++;
+}
+
+// ***** blockBegin *****
+void blockBegin(bool game, unsigned int addrStart, unsigned int addrCount){
+  if ((addrStart >= ramSize) || (addrCount == 0) || (addrCount > ramSize - addrStart)) {
+    serialPrintf_P(PSTR("> bload 0x%04X %u is outside the RAM\n"), addrStart, addrCount);
+    return;
+  }
+  blockNext = addrStart;
+  blockEnd = addrStart + addrCount;
+  blockState = BLOCK_HUNT;
+  blockNaks = 0;
+  blockLastByte = millis();
+  inputMode = game ? gameBlockMode : BlockMode;
+  serialPrintf_P(PSTR("> Send %u bytes from 0x%04X in blocks of up to %d\n"), addrCount, addrStart, BLOCK_MAX_DATA);
+  blockAck(BLOCK_OK);
+}
+
+// ***** blockFinish *****
+void blockFinish(const char *reason){
+  inputMode = CommandMode;
+  serialPrintf_P(PSTR("> bload %s at 0x%04X, %u NAKs\n"), reason, blockNext, blockNaks);
+}
+
+// ***** blockWrite *****
+// write and read back one block, the mirror buffer for the chip holds the data so the kernels can index it
+void blockWrite(){
+  unsigned int address = (blockPayload[0] << 8) | blockPayload[1];
+  unsigned int count = blockLength - 2;
+
+  if ((blockType != FRAME_TYPE_BLOCK) || (blockLength < 2) || (address != blockNext) || (count > blockEnd - address)) {
+    blockAck(BLOCK_BAD_ADDRESS);
+    return;
+  }
+
+  bool verified;
+  byte routine = routineBegin(ROUTINE_WRITE);
+  if (inputMode == gameBlockMode) {
+    for (unsigned int i = 0; i < count; i++) gameRamBuffer[address + i] = blockPayload[2 + i];
+    ramWriteBurst<RAM_GAME>(address, address + count, gameRamBuffer);
+    verified = ramVerifyBurst<RAM_GAME>(address, address + count, gameRamBuffer);
+  }
+  else {
+    for (unsigned int i = 0; i < count; i++) ramBuffer[address + i] = blockPayload[2 + i];
+    ramWriteBurst<RAM_SHADOW>(address, address + count, ramBuffer);
+    verified = ramVerifyBurst<RAM_SHADOW>(address, address + count, ramBuffer);
+  }
+  routineEnd(routine);
+
+  if (!verified) {
+    blockAck(BLOCK_VERIFY_FAILED);
+    return;
+  }
+  blockNext += count;
+  blockAck(BLOCK_OK);
+  if (blockNext == blockEnd) blockFinish("done");
+}
+
+// ***** blockPoll *****
+// loop() calls this instead of reading command lines while a bload is running
+void blockPoll(){
+  while (Serial.available()) {
+    byte c = Serial.read();
+    blockLastByte = millis();
+
+    switch (blockState) {
+      case BLOCK_HUNT:
+        if (c == FRAME_SYNC) {
+          blockCrc = 0xFFFF;
+          blockState = BLOCK_TYPE;
+        }
+        break;
+      case BLOCK_TYPE:
+        blockType = c;
+        blockCrc = crc16Update(blockCrc, c);
+        blockState = BLOCK_LENGTH_LOW;
+        break;
+      case BLOCK_LENGTH_LOW:
+        blockLength = c;
+        blockCrc = crc16Update(blockCrc, c);
+        blockState = BLOCK_LENGTH_HIGH;
+        break;
+      case BLOCK_LENGTH_HIGH:
+        blockLength |= c << 8;
+        blockCrc = crc16Update(blockCrc, c);
+        blockIndex = 0;
+        if (blockLength > sizeof(blockPayload)) {
+          blockState = BLOCK_HUNT;
+          blockAck(BLOCK_BAD_CRC);
+        }
+        else blockState = (blockLength > 0) ? BLOCK_PAYLOAD : BLOCK_CRC_HIGH;
+        break;
+      case BLOCK_PAYLOAD:
+        blockPayload[blockIndex++] = c;
+        blockCrc = crc16Update(blockCrc, c);
+        if (blockIndex == blockLength) blockState = BLOCK_CRC_HIGH;
+        break;
+      case BLOCK_CRC_HIGH:
+        blockReceivedCrc = c << 8;
+        blockState = BLOCK_CRC_LOW;
+        break;
+      case BLOCK_CRC_LOW:
+        blockReceivedCrc |= c;
+        blockState = BLOCK_HUNT;
+        if (blockReceivedCrc != blockCrc) blockAck(BLOCK_BAD_CRC);
+        else if (blockType == FRAME_TYPE_STOP) blockFinish("stopped");
+        else blockWrite();
+        if (inputMode == CommandMode) return;
+        break;
+    }
+  }
+
+  if (millis() - blockLastByte > BLOCK_TIMEOUT_MS) blockFinish("timed out");   // overflow safe
+}
+
+// ***** Stats frame *****
+// The ESP32 asks for this every few seconds for its /metrics page. Fields are only ever added at the end,
+// the count in front lets an older ESP32 read a newer frame:
+//   millis, live BUSY faults, shadow BUSY faults, fault log dropped, ATmega BUSY_ waits,
+//   validate samples, retries, torn, bad BCD, failed
+
+#define STATS_FIELDS 10
+
+// ***** statsLong *****
+void statsLong(unsigned long value){
+  frameByte(value & 0xFF);
+  frameByte((value >> 8) & 0xFF);
+  frameByte((value >> 16) & 0xFF);
+  frameByte((value >> 24) & 0xFF);
+}
+
+// ***** statsFrame *****
+void statsFrame(){
+  noInterrupts();                      // the ISRs update these 16 bit counts
+  unsigned int busyFaults = BusyFaultCount;
+  unsigned int shadowFaults = ShadowFaultCount;
+  unsigned int dropped = faultDropped;
+  interrupts();
+
+  frameBegin(FRAME_TYPE_STATS, 1 + STATS_FIELDS * 4);
+  frameByte(STATS_FIELDS);
+  statsLong(millis());
+  statsLong(busyFaults);
+  statsLong(shadowFaults);
+  statsLong(dropped);
+  statsLong(ramBusyWaits);
+  statsLong(validateSamples);
+  statsLong(validateRetries);
+  statsLong(validateTorn);
+  statsLong(validateBadBcd);
+  statsLong(validateFailed);
+  frameEnd();
+}
+
+// ***** Bench *****
+// bench times each RAM routine with Timer1 at the full 16 MHz clock, 62.5 ns a count. A routine covers the
+// whole RAM BENCH_BLOCK bytes at a time with interrupts off, so TCNT1 can't wrap and the millis() and UART
+// interrupts stay out of the numbers. Writes send back what the reads before them found and each filled
+// block is written back from the buffer, so the RAM keeps its contents only while the 6800 is stopped,
+// anything it writes in between is overwritten with the older value.
+// Plain bench only reads the shadow RAM, safe with a game running. bench game, for the pinball powered
+// off, adds the shadow RAM writes and every game RAM routine. Even reading the game RAM hands the 6800
+// a BUSY on every byte it touches at the same time.
+
+const char *benchRoutineNames[] = { "", "read", "burst read", "write", "burst write", "fill" };
+
+// ***** benchRoutine *****
+// Timer1 counts for one routine over the whole RAM
+unsigned long benchRoutine(bool game, byte routine){
+  unsigned long counts = 0;
+
+  for (unsigned int address = 0; address < ramSize; address += BENCH_BLOCK) {
+    if (game) {
+      counts += ramTimeBlock<RAM_GAME>(routine, address, address + BENCH_BLOCK, gameRamBuffer);
+      if (routine == RAM_TIME_FILL) ramWriteBurst<RAM_GAME>(address, address + BENCH_BLOCK, gameRamBuffer);
+    }
+    else {
+      counts += ramTimeBlock<RAM_SHADOW>(routine, address, address + BENCH_BLOCK, ramBuffer);
+      if (routine == RAM_TIME_FILL) ramWriteBurst<RAM_SHADOW>(address, address + BENCH_BLOCK, ramBuffer);
+    }
+  }
+  return counts;
+}
+
+// ***** benchLine *****
+void benchLine(bool game, byte routine, unsigned int overhead){
+  unsigned long waits = ramBusyWaits;
+  noInterrupts();
+  unsigned int faults = game ? BusyFaultCount : ShadowFaultCount;
+  interrupts();
+
+  unsigned long counts = benchRoutine(game, routine);
+  unsigned long overheadCounts = (unsigned long)overhead * (ramSize / BENCH_BLOCK);
+  counts = (counts > overheadCounts) ? counts - overheadCounts : 0;
+  unsigned long tenths = counts * 625 / ramSize;        // tenths of a ns per byte
+
+  noInterrupts();
+  faults = (game ? BusyFaultCount : ShadowFaultCount) - faults;
+  interrupts();
+  serialPrintf_P(PSTR(">   %-12s %-6s %6lu.%lu %10lu %7u\n"), benchRoutineNames[routine], game ? "game" : "shadow",
+                tenths / 10, tenths % 10, ramBusyWaits - waits, faults);
+}
+
+// ***** bench *****
+void bench(bool game){
+  byte routine = routineBegin(ROUTINE_BENCH);
+  byte savedA = TCCR1A;
+  byte savedB = TCCR1B;
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10);                  // normal mode, no prescaler
+
+  unsigned int overhead = ramTimeBlock<RAM_SHADOW>(RAM_TIME_NONE, 0, 0, ramBuffer);
+  serialPrintf_P(PSTR("> bench %d bytes a routine, Timer1 at 16 MHz, %u counts overhead a block taken off\n"), ramSize, overhead);
+  Serial.println(F(">   routine      chip   ns/byte BUSY waits  faults"));
+  byte lastShadow = game ? RAM_TIME_FILL : RAM_TIME_BURST_READ;
+  for (byte test = RAM_TIME_READ; test <= lastShadow; test++) benchLine(false, test, overhead);
+  if (game) {
+    for (byte test = RAM_TIME_READ; test <= RAM_TIME_FILL; test++) benchLine(true, test, overhead);
+  }
+
+  TCCR1A = savedA;
+  TCCR1B = savedB;
+  routineEnd(routine);
+}
+
+// ***** March test *****
+// marchtest runs March C- on the shadow RAM, which finds stuck at, transition, address decoder and
+// coupling faults:
+//   any w0, up r0 w1, up r1 w0, down r0 w1, down r1 w0, any r0
+// It runs once for each data background in marchBackgrounds, with the complement as 1, so bits inside a
+// byte are tested against each other too. The range is saved to ramBuffer first and written back after.
+// The 6800 writes the shadow RAM as well, with the pinball running its writes show up as errors.
+
+#define MARCH_ELEMENTS 6
+struct MarchElement {
+  bool up;
+  bool read;
+  bool readOne;
+  bool write;
+  bool writeOne;
+};
+const MarchElement marchC[MARCH_ELEMENTS] = {
+  { true,  false, false, true,  false },   // any w0
+  { true,  true,  false, true,  true  },   // up r0 w1
+  { true,  true,  true,  true,  false },   // up r1 w0
+  { false, true,  false, true,  true  },   // down r0 w1
+  { false, true,  true,  true,  false },   // down r1 w0
+  { true,  true,  false, false, false },   // any r0
+};
+const byte marchBackgrounds[] = { 0x00, 0x55, 0x33, 0x0F };
+
+// ***** marchTest *****
+unsigned long marchTest(unsigned int addrStart, unsigned int addrCount){
+  unsigned int addrEnd = smaller(addrStart + addrCount, ramSize);
+  unsigned long errors = 0;
+  unsigned long started = millis();
+
+  byte routine = routineBegin(ROUTINE_MARCH);
+  ramReadBurst<RAM_SHADOW>(addrStart, addrEnd, ramBuffer);
+
+  for (byte background = 0; background < sizeof(marchBackgrounds); background++) {
+    byte zero = marchBackgrounds[background];
+    for (byte element = 0; element < MARCH_ELEMENTS; element++) {
+      const MarchElement &march = marchC[element];
+      byte expected = march.readOne ? (byte)~zero : zero;
+      byte value = march.writeOne ? (byte)~zero : zero;
+
+      for (unsigned int i = 0; i < addrEnd - addrStart; i++) {
+        unsigned int address = march.up ? addrStart + i : addrEnd - 1 - i;
+        if (march.read) {
+          byte dataByte = ramAccess<RAM_SHADOW, RAM_READ>(address);
+          if (dataByte != expected) {
+            if (errors < MARCH_MAX_REPORT) {
+              serialPrintf_P(PSTR("> M%d background 0x%02X address 0x%04X read 0x%02X expected 0x%02X\n"),
+                            element, zero, address, dataByte, expected);
+            }
+            errors++;
+          }
+        }
+        if (march.write) ramAccess<RAM_SHADOW, RAM_WRITE>(address, value);
+      }
+    }
+  }
+
+  ramWriteBurst<RAM_SHADOW>(addrStart, addrEnd, ramBuffer);
+  routineEnd(routine);
+  serialPrintf_P(PSTR("> March C- 0x%04X to 0x%04X, %d backgrounds, %lu ms, %lu errors\n"),
+                addrStart, addrEnd - 1, (int)sizeof(marchBackgrounds), millis() - started, errors);
+  return errors;
+}
+
 // ***** compareBuffer *****
 void compareBuffer( unsigned int addrStart, unsigned int addrCount){
 
@@ -726,12 +1658,12 @@ void compareBuffer( unsigned int addrStart, unsigned int addrCount){
     byte ramByte = readAddress(address);
     byte buffByte = ramBuffer[address]; 
     if (ramByte != buffByte){ 
-      Serial.printf("address 0x%04X: ramBuffer 0x%02X buffByte 0x%02X\n", address, ramByte, buffByte );
-      Serial.println("  Subtest");
+      serialPrintf_P(PSTR("address 0x%04X: ramBuffer 0x%02X buffByte 0x%02X\n"), address, ramByte, buffByte );
+      Serial.println(F("  Subtest"));
       for (int i=0; i<10; i++) {
         byte ramByte = readAddress(address);
         byte buffByte = ramBuffer[address]; 
-        Serial.printf(" address 0x%04X: ramBuffer 0x%02X buffByte 0x%02X\n", address, ramByte, buffByte );
+        serialPrintf_P(PSTR(" address 0x%04X: ramBuffer 0x%02X buffByte 0x%02X\n"), address, ramByte, buffByte );
       }
     }
   }        
@@ -742,9 +1674,11 @@ void compareBuffer( unsigned int addrStart, unsigned int addrCount){
 void testMemory(unsigned int addrStart, unsigned int addrCount, int testLoops) {
 
   for (int i = 0; i < testLoops; i++){
-    Serial.printf(">Memory loop test %d\n", i);  
+    serialPrintf_P(PSTR(">Memory loop test %d\n"), i);  
+    byte routine = routineBegin(ROUTINE_TEST);
     fillRandomRange(addrStart, addrCount); //dataByte is recreated for each address of range
     refreshBuffer(addrStart, addrCount);
+    routineEnd(routine);
     compareBuffer(addrStart, addrCount);
   }
 }
@@ -752,13 +1686,16 @@ void testMemory(unsigned int addrStart, unsigned int addrCount, int testLoops) {
 void BusyFaultWarning(){
   BusyStateIRQ = LOW;
   ++BusyFaultCount;
-  BusyFaultAddress = (((PORTC & B0000111) << 8 ) | PORTA);
+  BusyFaultAddress = (((PORTC & RAM_ADDRESS_HIGH_MASK) << 8 ) | PORTA);
+  faultLog(FAULT_LIVE, BusyFaultAddress);
+  flightFault(BusyFaultAddress);
   }
 
 void ShadowFaultWarning(){
   ShadowStateIRQ = LOW;
   ++ShadowFaultCount;
-  ShadowFaultAddress = (((PORTC & B0000111) << 8 ) | PORTA);
+  ShadowFaultAddress = (((PORTC & RAM_ADDRESS_HIGH_MASK) << 8 ) | PORTA);
+  faultLog(FAULT_SHADOW, ShadowFaultAddress);
   }
 
 // ***** setup ***** -----------------------------------------------
@@ -779,7 +1716,7 @@ void setup() {
   helpText();
 
   #ifdef _DEBUG_
-    Serial.println("_DEBUG_ is defined");
+    Serial.println(F("_DEBUG_ is defined"));
   #endif
 
   PINA= B11111111;      //This might be the way to set input pull-up before changing PORTA direction to output
@@ -817,18 +1754,30 @@ void setup() {
 // ***** loop ***** ----------------------------------------
 void loop() {
 
+  // nothing else goes out on Serial while the host waits for block answers, a fault print while a block
+  // arrives would overrun the 64 byte receive buffer. Faults raised by gamebload are printed once
+  // blockFinish has gone back to command mode, with the last address and the count so far.
+  if ((inputMode == BlockMode) || (inputMode == gameBlockMode)) {
+    blockPoll();
+    return;
+  }
+
   if (BusyStateIRQ == LOW ) {
     BusyStateIRQ = HIGH; 
-    Serial.printf("\n> PIN_PD2 IRQ 0 Busy fault Live Game RAM issued a BUSY, Address: 0x%04X\n", BusyFaultAddress );
-    Serial.printf("> Cumlative fault count since last Atmega1284 reboot: %d\n", BusyFaultCount );
+    serialPrintf_P(PSTR("\n> PIN_PD2 IRQ 0 Busy fault Live Game RAM issued a BUSY, Address: 0x%04X\n"), BusyFaultAddress );
+    serialPrintf_P(PSTR("> Cumlative fault count since last Atmega1284 reboot: %d\n"), BusyFaultCount );
   }
 
   if (ShadowStateIRQ == LOW ) {
     ShadowStateIRQ = HIGH; 
-    Serial.printf("\n> PIN_PD3 IRQ 1 Busy fault Shadow RAM issued a BUSY, Address: 0x%04X\n", ShadowFaultAddress );
-    Serial.printf("> Cumlative Shadow fault count since last Atmega1284 reboot: %d\n", ShadowFaultCount );
+    serialPrintf_P(PSTR("\n> PIN_PD3 IRQ 1 Busy fault Shadow RAM issued a BUSY, Address: 0x%04X\n"), ShadowFaultAddress );
+    serialPrintf_P(PSTR("> Cumlative Shadow fault count since last Atmega1284 reboot: %d\n"), ShadowFaultCount );
   }
 
+  watchPoll();
+  diffPoll();
+  flightPoll();
+
 bool received = getCommandLineFromSerialPort(CommandLine);      //global CommandLine is defined in CommandLine.h
   if (received) {
     switch(inputMode){
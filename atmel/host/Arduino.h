@@ -0,0 +1,166 @@
+// Arduino.h
+// Host stand-in for the parts of the Arduino core that atmel.ino uses.
+//
+// The AVR register names the sketch touches are SimRegister objects. Writing PORTA, PORTB, PORTC or DDRB
+// moves the simulated IDT7132 pins and reading PINB returns whatever the simulated RAM drives on the
+// data bus, see Idt7132Sim.h. Every register access, BUS_NOP and Serial byte advances the
+// simulated 16MHz cycle counter that millis(), micros() and the 6800 on the right hand port run from.
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <math.h>
+#include "binary.h"
+
+#define HOST_BUILD
+
+typedef uint8_t byte;
+typedef uint16_t word;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+// ATmega1284 pin numbers, MightyCore standard pinout
+#define PIN_PB0 0
+#define PIN_PD0 8
+#define PIN_PD1 9
+#define PIN_PD2 10
+#define PIN_PD3 11
+#define PIN_PD4 12
+#define PIN_PD5 13
+#define PIN_PD6 14
+#define PIN_PD7 15
+#define PIN_PC0 16
+#define PIN_PA0 24
+
+// bit numbers inside PORTD / PIND
+#define PD2 2
+#define PD3 3
+#define PD7 7
+
+// flash strings are ordinary strings here, there is only one address space
+#define PGM_P const char *
+#define PSTR(text) (text)
+#define F(text) (text)
+#define vsnprintf_P vsnprintf
+
+#define _BV(bit) (1 << (bit))
+#define lowByte(w) ((uint8_t) ((w) & 0xff))
+#define highByte(w) ((uint8_t) ((w) >> 8))
+
+// a NOP on the bus is one AVR cycle
+void simNop();
+#define BUS_NOP simNop()
+
+// ***** SimRegister *****
+// An 8 bit AVR I/O register. Stores and loads cost AVR cycles and let the simulated RAMs react.
+class SimRegister {
+  public:
+    explicit SimRegister(const char *registerName) : name(registerName), value(0) {}
+
+    SimRegister &operator=(uint8_t newValue);
+    SimRegister &operator&=(uint8_t mask);
+    SimRegister &operator|=(uint8_t mask);
+    operator uint8_t() const;
+
+    const char *name;
+    uint8_t value;
+};
+
+extern SimRegister PORTA, DDRA, PINA;
+extern SimRegister PORTB, DDRB, PINB;
+extern SimRegister PORTC, DDRC, PINC;
+extern SimRegister PORTD, DDRD, PIND;
+
+// ***** SimTimer16 *****
+// TCNT1 counts simulated AVR cycles while TCCR1B selects clk/1, otherwise it reads back the value written,
+// the other prescalers aren't modelled. Enough for the bench command.
+class SimTimer16 {
+  public:
+    SimTimer16 &operator=(uint16_t newValue);
+    operator uint16_t() const;
+
+    uint16_t value = 0;
+    uint64_t since = 0;                 // cycle the value was written
+};
+
+extern SimRegister TCCR1A, TCCR1B;
+extern SimTimer16 TCNT1;
+
+#define CS10 0
+#define CS11 1
+#define CS12 2
+
+// ***** Serial *****
+// Input comes from the host harness, output goes to stdout unless the harness mutes it.
+class HostSerial {
+  public:
+    void begin(unsigned long baud);
+    int available();
+    int read();
+    size_t write(uint8_t dataByte);
+    size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *text);
+    int printf(const char *format, ...);
+
+    size_t print(const char *text);
+    size_t print(char c);
+    size_t print(int value);
+    size_t print(unsigned int value);
+    size_t print(long value);
+    size_t print(unsigned long value);
+    size_t println();
+    size_t println(const char *text);
+    size_t println(char c);
+    size_t println(int value);
+    size_t println(unsigned int value);
+    size_t println(long value);
+    size_t println(unsigned long value);
+
+    unsigned long baudRate = 115200;
+};
+
+extern HostSerial Serial;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalPinToInterrupt(uint8_t pin);
+void attachInterrupt(uint8_t interruptNumber, void (*isr)(), int mode);
+void noInterrupts();
+void interrupts();
+
+long random(long howBig);
+long random(long howSmall, long howBig);
+void randomSeed(unsigned long seed);
+
+bool isPrintable(int c);
+
+// host harness hooks, not part of the Arduino core
+void hostSerialInput(const char *text);    // queue text for Serial.read()
+void hostSerialInputBytes(const uint8_t *data, size_t size);  // binary input, for bload blocks
+void hostSerialReset();                     // empty both directions, used when the simulation restarts
+extern bool hostSerialMuted;                // true drops Serial output instead of writing it to stdout
+extern unsigned long hostSerialBytesOut;
+
+#endif
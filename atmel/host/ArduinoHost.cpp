@@ -0,0 +1,244 @@
+// ArduinoHost.cpp
+// Host implementation of the Arduino core calls declared in Arduino.h
+
+#include <stdarg.h>
+#include <string>
+#include "Arduino.h"
+#include "Idt7132Sim.h"
+
+#define SERIAL_TX_BUFFER_SIZE 64    // HardwareSerial waits once this many bytes are queued
+#define SERIAL_WRITE_CYCLES 20      // putting one byte in the TX buffer
+
+SimRegister PORTA("PORTA"), DDRA("DDRA"), PINA("PINA");
+SimRegister PORTB("PORTB"), DDRB("DDRB"), PINB("PINB");
+SimRegister PORTC("PORTC"), DDRC("DDRC"), PINC("PINC");
+SimRegister PORTD("PORTD"), DDRD("DDRD"), PIND("PIND");
+SimRegister TCCR1A("TCCR1A"), TCCR1B("TCCR1B");
+SimTimer16 TCNT1;
+
+HostSerial Serial;
+
+bool hostSerialMuted = false;
+unsigned long hostSerialBytesOut = 0;
+
+static std::string serialInput;
+static size_t serialInputPos = 0;
+static uint64_t serialTxIdleAt = 0;          // cycle the UART finishes the bytes already queued
+static uint32_t sketchRandomState = 1;
+
+// ***** SimRegister *****
+
+static bool drivesRam(const SimRegister *reg){
+  return (reg == &PORTA) || (reg == &PORTB) || (reg == &PORTC) || (reg == &DDRB) || (reg == &DDRC);
+}
+
+SimRegister &SimRegister::operator=(uint8_t newValue){
+  busSim.advance(1);                                     // out
+  value = newValue;
+  if (drivesRam(this)) busSim.portsChanged();
+  return *this;
+}
+
+SimRegister &SimRegister::operator&=(uint8_t mask){
+  busSim.advance(__builtin_popcount((uint8_t)~mask) == 1 ? 2 : 3);   // cbi, or in andi out
+  value &= mask;
+  if (drivesRam(this)) busSim.portsChanged();
+  return *this;
+}
+
+SimRegister &SimRegister::operator|=(uint8_t mask){
+  busSim.advance(__builtin_popcount(mask) == 1 ? 2 : 3);             // sbi, or in ori out
+  value |= mask;
+  if (drivesRam(this)) busSim.portsChanged();
+  return *this;
+}
+
+SimRegister::operator uint8_t() const {
+  busSim.advance(1);                                     // in
+  if (this == &PINB) return busSim.dataBus();
+  if (this == &PIND) {
+    uint8_t pins = 0xFF;                                 // pull ups, fault interrupt lines idle high
+    if (busSim.busyLow()) pins &= ~_BV(PD7);
+    return (pins & ~DDRD.value) | (PORTD.value & DDRD.value);
+  }
+  if (this == &PINA) return PORTA.value;
+  if (this == &PINC) return PORTC.value;
+  return value;
+}
+
+void simNop(){
+  busSim.advance(1);
+}
+
+// ***** Serial *****
+
+void HostSerial::begin(unsigned long baud){
+  baudRate = baud;
+}
+
+int HostSerial::available(){
+  return serialInput.size() - serialInputPos;
+}
+
+int HostSerial::read(){
+  if (serialInputPos >= serialInput.size()) return -1;
+  return (uint8_t)serialInput[serialInputPos++];
+}
+
+size_t HostSerial::write(uint8_t dataByte){
+  uint64_t byteCycles = 10ULL * AVR_CYCLES_PER_US * 1000000ULL / baudRate;
+
+  busSim.advance(SERIAL_WRITE_CYCLES);
+  if (serialTxIdleAt < busSim.now) serialTxIdleAt = busSim.now;
+  uint64_t queued = serialTxIdleAt - busSim.now;
+  if (queued > SERIAL_TX_BUFFER_SIZE * byteCycles) busSim.advance(queued - SERIAL_TX_BUFFER_SIZE * byteCycles);
+  serialTxIdleAt += byteCycles;
+
+  hostSerialBytesOut++;
+  if (!hostSerialMuted) fputc(dataByte, stdout);
+  return 1;
+}
+
+size_t HostSerial::write(const uint8_t *buffer, size_t size){
+  for (size_t i = 0; i < size; i++) write(buffer[i]);
+  return size;
+}
+
+size_t HostSerial::write(const char *text){
+  return write((const uint8_t *)text, strlen(text));
+}
+
+int HostSerial::printf(const char *format, ...){
+  char text[256];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  write(text);
+  return length;
+}
+
+size_t HostSerial::print(const char *text) { return write(text); }
+size_t HostSerial::print(char c) { return write((uint8_t)c); }
+size_t HostSerial::print(int value) { return printf("%d", value); }
+size_t HostSerial::print(unsigned int value) { return printf("%u", value); }
+size_t HostSerial::print(long value) { return printf("%ld", value); }
+size_t HostSerial::print(unsigned long value) { return printf("%lu", value); }
+size_t HostSerial::println() { return write("\r\n"); }
+size_t HostSerial::println(const char *text) { return print(text) + println(); }
+size_t HostSerial::println(char c) { return print(c) + println(); }
+size_t HostSerial::println(int value) { return print(value) + println(); }
+size_t HostSerial::println(unsigned int value) { return print(value) + println(); }
+size_t HostSerial::println(long value) { return print(value) + println(); }
+size_t HostSerial::println(unsigned long value) { return print(value) + println(); }
+
+void hostSerialInput(const char *text){
+  serialInput.erase(0, serialInputPos);
+  serialInputPos = 0;
+  serialInput += text;
+}
+
+void hostSerialInputBytes(const uint8_t *data, size_t size){
+  serialInput.erase(0, serialInputPos);
+  serialInputPos = 0;
+  serialInput.append((const char *)data, size);
+}
+
+void hostSerialReset(){
+  serialInput.clear();
+  serialInputPos = 0;
+  serialTxIdleAt = 0;
+}
+
+// ***** Timer1 *****
+
+SimTimer16 &SimTimer16::operator=(uint16_t newValue){
+  busSim.advance(2);                                     // sts high, sts low
+  value = newValue;
+  since = busSim.now;
+  return *this;
+}
+
+SimTimer16::operator uint16_t() const {
+  busSim.advance(2);                                     // lds low, lds high
+  if ((TCCR1B.value & 0x07) != _BV(CS10)) return value;
+  return (uint16_t)(value + (busSim.now - since));
+}
+
+// ***** time *****
+
+unsigned long millis(){
+  return busSim.now / (AVR_CYCLES_PER_US * 1000);
+}
+
+unsigned long micros(){
+  return busSim.now / AVR_CYCLES_PER_US;
+}
+
+void delay(unsigned long ms){
+  while (ms--) busSim.advance(AVR_CYCLES_PER_US * 1000);
+}
+
+void delayMicroseconds(unsigned int us){
+  busSim.advance(us * AVR_CYCLES_PER_US);
+}
+
+// ***** pins *****
+
+void pinMode(uint8_t pin, uint8_t mode){
+  (void)pin;
+  (void)mode;
+}
+
+int digitalRead(uint8_t pin){
+  busSim.advance(DIGITAL_READ_CYCLES);
+  if (pin == PIN_PD7) return busSim.busyLow() ? LOW : HIGH;
+  return HIGH;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value){
+  (void)pin;
+  (void)value;
+}
+
+int digitalPinToInterrupt(uint8_t pin){
+  if (pin == PIN_PD2) return 0;
+  if (pin == PIN_PD3) return 1;
+  return -1;
+}
+
+// INT0 on PD2 is the live game RAM BUSY fault, INT1 on PD3 the shadow RAM
+void attachInterrupt(uint8_t interruptNumber, void (*isr)(), int mode){
+  (void)mode;
+  if (interruptNumber == 0) busSim.attachFaultInterrupt(SIM_LIVE_CHIP, isr);
+  if (interruptNumber == 1) busSim.attachFaultInterrupt(SIM_SHADOW_CHIP, isr);
+}
+
+void noInterrupts(){
+  busSim.setInterruptsEnabled(false);
+}
+
+void interrupts(){
+  busSim.setInterruptsEnabled(true);
+}
+
+// ***** random *****
+
+long random(long howBig){
+  if (howBig <= 0) return 0;
+  sketchRandomState = sketchRandomState * 1103515245 + 12345;
+  return (sketchRandomState >> 8) % howBig;
+}
+
+long random(long howSmall, long howBig){
+  if (howSmall >= howBig) return howSmall;
+  return howSmall + random(howBig - howSmall);
+}
+
+void randomSeed(unsigned long seed){
+  if (seed != 0) sketchRandomState = seed;
+}
+
+bool isPrintable(int c){
+  return isprint(c);
+}
@@ -0,0 +1,219 @@
+// Idt7132Sim.cpp
+// see Idt7132Sim.h
+
+#include <string.h>
+#include "Arduino.h"
+#include "Idt7132Sim.h"
+
+Idt7132Sim busSim;
+
+static const uint8_t ceBit[SIM_CHIPS] = { B01000000, B10000000 };   // CEL_ PC6, CEL2_ PC7
+#define OE_BIT B00010000                                            // OEL_ PC4
+#define RW_BIT B00100000                                            // RWL_ PC5
+
+// ***** reset *****
+void Idt7132Sim::reset(uint32_t seed){
+  now = 0;
+  nextMpuCycle = 0;
+  randomState = seed ? seed : 1;
+  memset(mem, 0, sizeof(mem));
+  memset(stats, 0, sizeof(stats));
+  for (uint8_t chip = 0; chip < SIM_CHIPS; chip++) {
+    left[chip] = LeftPort();
+    pendingFault[chip] = false;
+  }
+  mpu = MpuCycle();
+  portsChanged();
+}
+
+// ***** controlLines *****
+// PORTC pins not yet set as outputs are pulled high on the board, so the chips stay deselected until setup()
+static uint8_t controlLines(){
+  return (PORTC.value & DDRC.value) | (~DDRC.value & 0xFF);
+}
+
+// ***** portsChanged *****
+void Idt7132Sim::portsChanged(){
+  uint8_t control = controlLines();
+  uint16_t address = ((control & B00000111) << 8) | PORTA.value;
+  bool rwLow = !(control & RW_BIT);
+
+  for (uint8_t chip = 0; chip < SIM_CHIPS; chip++) {
+    LeftPort &port = left[chip];
+    bool ceLow = !(control & ceBit[chip]);
+
+    if (ceLow && !port.ceLow) {
+      port.ceLow = true;
+      port.ceSince = now;
+      port.address = address;
+      port.busyUntil = 0;
+      if (mpu.active && (now < mpu.end) && (mpu.address == address)) {   // the 6800 got there first
+        port.busyUntil = mpu.end;
+        stats[chip].leftBusyHits++;
+      }
+    }
+    else if (ceLow) {
+      port.address = address;
+    }
+
+    // a write lands on whichever of CE or R/W rises first
+    bool armed = ceLow && rwLow;
+    if (port.writeArmed && !armed) {
+      stats[chip].leftWrites++;
+      if (now < port.busyUntil) stats[chip].leftWritesLost++;
+      else mem[chip][port.address] = (PORTB.value & DDRB.value) | (~DDRB.value & 0xFF);
+    }
+    port.writeArmed = armed;
+
+    if (!ceLow && port.ceLow) {
+      uint64_t window = now - port.ceSince;
+      port.ceLow = false;
+      stats[chip].ceLowCycles += window;
+      stats[chip].ceWindows++;
+      if (window > stats[chip].ceLongestWindow) stats[chip].ceLongestWindow = window;
+    }
+  }
+}
+
+// ***** dataBus *****
+uint8_t Idt7132Sim::dataBus(){
+  uint8_t value = 0xFF;                   // nothing driving the bus
+  uint8_t control = controlLines();
+  bool reading = !(control & OE_BIT) && (control & RW_BIT);
+
+  for (uint8_t chip = 0; chip < SIM_CHIPS; chip++) {
+    if (reading && left[chip].ceLow) {
+      value &= mem[chip][left[chip].address];
+      stats[chip].leftReads++;
+    }
+  }
+  return (value & ~DDRB.value) | (PORTB.value & DDRB.value);
+}
+
+// ***** busyLow *****
+bool Idt7132Sim::busyLow(){
+  for (uint8_t chip = 0; chip < SIM_CHIPS; chip++) {
+    if (left[chip].ceLow && (now < left[chip].busyUntil)) return true;
+  }
+  return false;
+}
+
+// ***** advance *****
+void Idt7132Sim::advance(uint32_t cycles){
+  now += cycles;
+  if (inAdvance) return;                  // an interrupt handler touching a register while the 6800 runs
+
+  if (!mpuEnabled) {                      // no 6800 cycles at all, not one per advance
+    nextMpuCycle = now + 1;
+    mpu.active = false;
+    return;
+  }
+
+  inAdvance = true;
+  while (nextMpuCycle <= now) {
+    mpuStep(nextMpuCycle);
+    nextMpuCycle += MPU_CYCLE_AVR_CYCLES;
+  }
+  inAdvance = false;
+}
+
+// ***** mpuStep *****
+// one 6800 bus cycle starting at cycle
+void Idt7132Sim::mpuStep(uint64_t cycle){
+  mpu.active = false;
+  if ((int)(nextRandom() % 100) >= mpuLoadPercent) return;
+
+  bool write;
+  uint16_t address = mpuAddress(write);
+  uint8_t data = write ? (uint8_t)nextRandom() : mem[SIM_LIVE_CHIP][address];
+
+  mpu.active = true;
+  mpu.address = address;
+  mpu.end = cycle + MPU_CYCLE_AVR_CYCLES;
+
+  for (uint8_t chip = 0; chip < SIM_CHIPS; chip++) {
+    LeftPort &port = left[chip];
+    bool chipWrite = write || (chip == SIM_SHADOW_CHIP);   // a 6800 read is copied into the shadow
+
+    stats[chip].mpuAccesses++;
+    if (port.ceLow && (port.address == address) && (now >= port.busyUntil)) {   // the ATmega got there first
+      stats[chip].mpuBusy++;
+      if (chipWrite) stats[chip].mpuWritesLost++;
+      fault(chip);
+      continue;
+    }
+    if (chipWrite) mem[chip][address] = data;
+  }
+}
+
+// ***** mpuAddress *****
+// rough 6800 RAM use: zero page variables, the stack near 0x01FF, the rest of page 1, then everything above
+uint16_t Idt7132Sim::mpuAddress(bool &write){
+  uint32_t region = nextRandom() % 100;
+  uint32_t r = nextRandom();
+
+  if (region < 40) {
+    write = (r & 0x300) == 0;
+    return r & 0xFF;
+  }
+  if (region < 75) {
+    write = (r & 0x100) == 0;
+    return 0x01E0 + (r & 0x1F);
+  }
+  if (region < 90) {
+    write = (r & 0x300) == 0;
+    return 0x0100 + (r & 0xFF) % 0xE0;
+  }
+  write = (r & 0x3000) == 0;
+  return 0x0200 + (r % 0x0600);
+}
+
+// ***** nextRandom *****
+uint32_t Idt7132Sim::nextRandom(){
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState;
+}
+
+// ***** fault *****
+void Idt7132Sim::fault(uint8_t chip){
+  if (interruptsEnabled && faultIsr[chip]) faultIsr[chip]();
+  else pendingFault[chip] = true;
+}
+
+// ***** attachFaultInterrupt *****
+void Idt7132Sim::attachFaultInterrupt(uint8_t chip, void (*isr)()){
+  faultIsr[chip] = isr;
+}
+
+// ***** setInterruptsEnabled *****
+void Idt7132Sim::setInterruptsEnabled(bool enabled){
+  interruptsEnabled = enabled;
+  if (!enabled) return;
+  for (uint8_t chip = 0; chip < SIM_CHIPS; chip++) {
+    if (pendingFault[chip]) {
+      pendingFault[chip] = false;
+      if (faultIsr[chip]) faultIsr[chip]();
+    }
+  }
+}
+
+// ***** total *****
+BusStats Idt7132Sim::total() const {
+  BusStats sum;
+  memset(&sum, 0, sizeof(sum));
+  for (uint8_t chip = 0; chip < SIM_CHIPS; chip++) {
+    sum.ceLowCycles += stats[chip].ceLowCycles;
+    sum.ceWindows += stats[chip].ceWindows;
+    if (stats[chip].ceLongestWindow > sum.ceLongestWindow) sum.ceLongestWindow = stats[chip].ceLongestWindow;
+    sum.leftReads += stats[chip].leftReads;
+    sum.leftWrites += stats[chip].leftWrites;
+    sum.leftBusyHits += stats[chip].leftBusyHits;
+    sum.leftWritesLost += stats[chip].leftWritesLost;
+    sum.mpuAccesses += stats[chip].mpuAccesses;
+    sum.mpuBusy += stats[chip].mpuBusy;
+    sum.mpuWritesLost += stats[chip].mpuWritesLost;
+  }
+  return sum;
+}
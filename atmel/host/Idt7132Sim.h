@@ -0,0 +1,109 @@
+// Idt7132Sim.h
+// Cycle approximate model of the memory tap board: two IDT7132 2K x 8 dual port RAMs,
+// the ATmega1284 on their left hand ports and the pinball 6800 on their right hand ports.
+//
+// Left port, driven by atmel.ino through BusHal.h
+//   PORTA address low byte, PORTC bits 0..2 address high bits, PORTC bit 4 OE, bit 5 R/W,
+//   bit 6 CE of the shadow RAM (CEL_), bit 7 CE of the live game RAM (CEL2_), PORTB data bus.
+//   BUSY_ (PIN_PD7) is the left hand BUSY output of whichever chip is enabled.
+//
+// Right port, the 6800
+//   One 6800 bus cycle every MPU_CYCLE_AVR_CYCLES. mpuLoadPercent of the cycles touch the RAM,
+//   the rest are ROM and I/O. The address mix leans on the zero page and the stack at 0x01E0.
+//   A 6800 write goes to both chips. A 6800 read comes from the live chip and the board copies
+//   the byte into the shadow chip, so the shadow sees a write on every 6800 RAM cycle.
+//
+// Arbitration, same as the IDT7132 data sheet: whichever side's CE lands on the address first keeps it.
+//   ATmega first: the 6800 gets BUSY_R. Its write is dropped, that is game RAM corruption,
+//     and the BUSY fault interrupt fires, PD2 for the live RAM and PD3 for the shadow.
+//   6800 first: BUSY_ goes low to the ATmega until the 6800 cycle ends.
+//     An ATmega write that finishes while BUSY_ is still low is dropped.
+//
+// Costs are counted in 16MHz AVR cycles: a register store or load is one cycle, a read modify
+// write of PORTC is three (two for a single bit sbi/cbi), digitalRead() is 56.
+// Loop and call overhead in the sketch is not counted, so absolute numbers are a floor.
+// The CE low windows only come from register stores, so they are counted exactly.
+
+#ifndef Idt7132Sim_h
+#define Idt7132Sim_h
+
+#include <stdint.h>
+
+#define SIM_RAM_SIZE 2048
+#define SIM_CHIPS 2
+#define SIM_SHADOW_CHIP 0        // CEL_  PC6, fault on PD3 INT1
+#define SIM_LIVE_CHIP 1          // CEL2_ PC7, fault on PD2 INT0
+#define AVR_CYCLES_PER_US 16
+#define MPU_CYCLE_AVR_CYCLES 16  // 6800 E clock is 1MHz
+#define DIGITAL_READ_CYCLES 56
+
+struct BusStats {
+  uint64_t ceLowCycles;          // total time CE was held low, the contention window
+  uint32_t ceWindows;            // number of CE low pulses
+  uint32_t ceLongestWindow;      // longest single CE low pulse in cycles
+  uint32_t leftReads;
+  uint32_t leftWrites;
+  uint32_t leftBusyHits;         // ATmega accesses that found the 6800 on the address, BUSY_ went low
+  uint32_t leftWritesLost;       // ATmega writes dropped because BUSY_ was still low
+  uint32_t mpuAccesses;          // 6800 RAM cycles that reached this chip
+  uint32_t mpuBusy;              // BUSY_R given to the 6800, each one is a fault interrupt
+  uint32_t mpuWritesLost;        // 6800 writes dropped, corrupted game RAM
+};
+
+class Idt7132Sim {
+  public:
+    void reset(uint32_t seed);
+
+    // called by SimRegister after PORTA, PORTB, PORTC or DDRB changes
+    void portsChanged();
+    uint8_t dataBus();           // what PINB reads
+    bool busyLow();              // level of BUSY_ on PIN_PD7
+
+    // move simulated time forward, the 6800 runs its bus cycles as time passes
+    void advance(uint32_t cycles);
+
+    void attachFaultInterrupt(uint8_t chip, void (*isr)());
+    void setInterruptsEnabled(bool enabled);
+
+    BusStats total() const;
+
+    uint64_t now = 0;            // AVR cycles since reset
+    uint8_t mem[SIM_CHIPS][SIM_RAM_SIZE];
+    BusStats stats[SIM_CHIPS];
+
+    bool mpuEnabled = true;
+    int mpuLoadPercent = 50;     // percent of 6800 bus cycles that use the RAM
+
+  private:
+    struct LeftPort {
+      bool ceLow = false;
+      bool writeArmed = false;   // CE and R/W both low, the write lands when either rises
+      uint16_t address = 0;
+      uint64_t ceSince = 0;
+      uint64_t busyUntil = 0;    // BUSY_ is low until this cycle
+    };
+
+    struct MpuCycle {
+      bool active = false;
+      uint16_t address = 0;
+      uint64_t end = 0;
+    };
+
+    void mpuStep(uint64_t cycle);
+    uint16_t mpuAddress(bool &write);
+    uint32_t nextRandom();
+    void fault(uint8_t chip);
+
+    LeftPort left[SIM_CHIPS];
+    MpuCycle mpu;
+    uint64_t nextMpuCycle = 0;
+    uint32_t randomState = 1;
+    bool inAdvance = false;
+    bool interruptsEnabled = true;
+    bool pendingFault[SIM_CHIPS] = { false, false };
+    void (*faultIsr[SIM_CHIPS])() = { nullptr, nullptr };
+};
+
+extern Idt7132Sim busSim;
+
+#endif
@@ -0,0 +1,273 @@
+// main.cpp
+// Linux host build of atmel.ino against the simulated IDT7132 pair in Idt7132Sim.h
+//
+//   ./atmel_sim [options] < commands.txt    run setup(), feed each line to the command parser, print the replies
+//                                           a "#wait ms" line runs loop() for that long before the next command
+//                                           a "#raw hex" line feeds the bytes given as hex pairs, for bload blocks
+//   ./atmel_sim --bench [options]           bus cycle and contention report for each RAM routine
+//
+// see README.md for the options
+
+#include <string>
+#include "Arduino.h"
+#include "Idt7132Sim.h"
+#include "../atmel.ino"
+
+#define LOOP_OVERHEAD_CYCLES 40     // one pass of loop() with nothing to do
+#define DEFAULT_RUN_MS 100          // keep loop() going after the last command so watch and diff streams show up
+#define DEFAULT_BENCH_RUNS 10
+
+static uint32_t simSeed = 1;
+static const char *dumpFile = NULL;
+static uint8_t dumpImage[SIM_RAM_SIZE];
+
+// ***** loadDump *****
+// read a dumps/*.txt style file, "0x0000: 0x48 0x00 ..."
+static bool loadDump(const char *fileName){
+  FILE *file = fopen(fileName, "r");
+  if (file == NULL) return false;
+
+  char line[256];
+  while (fgets(line, sizeof(line), file)) {
+    char *text = line;
+    char *end;
+    unsigned long address = strtoul(text, &end, 16);
+    if ((end == text) || (*end != ':')) continue;
+    text = end + 1;
+    for (;;) {
+      unsigned long value = strtoul(text, &end, 16);
+      if (end == text) break;
+      if (address < SIM_RAM_SIZE) dumpImage[address++] = value;
+      text = end;
+    }
+  }
+  fclose(file);
+  return true;
+}
+
+// ***** simReset *****
+static void simReset(){
+  busSim.reset(simSeed);
+  hostSerialReset();
+  if (dumpFile) {
+    memcpy(busSim.mem[SIM_SHADOW_CHIP], dumpImage, SIM_RAM_SIZE);
+    memcpy(busSim.mem[SIM_LIVE_CHIP], dumpImage, SIM_RAM_SIZE);
+  }
+}
+
+// ***** runLoop *****
+static void runLoop(unsigned long ms){
+  unsigned long start = millis();
+  while (millis() - start < ms) {
+    loop();
+    busSim.advance(LOOP_OVERHEAD_CYCLES);
+  }
+}
+
+// ***** runCommands *****
+static void runCommands(unsigned long runMs){
+  char line[1024];
+
+  setup();
+  while (fgets(line, sizeof(line), stdin)) {
+    if (strncmp(line, "#wait", 5) == 0) {           // #wait ms keeps loop() running between commands
+      runLoop(strtoul(line + 5, NULL, 0));
+      continue;
+    }
+    if (strncmp(line, "#raw", 4) == 0) {            // #raw A54204... binary input
+      uint8_t bytes[sizeof(line) / 2];
+      size_t count = 0;
+      unsigned int value;
+      int used;
+      for (char *text = line + 4; sscanf(text, " %2x%n", &value, &used) == 1; text += used) bytes[count++] = value;
+      hostSerialInputBytes(bytes, count);
+    }
+    else hostSerialInput(line);
+    while (Serial.available()) {
+      loop();
+      busSim.advance(LOOP_OVERHEAD_CYCLES);
+    }
+  }
+  runLoop(runMs);
+  fflush(stdout);
+
+  BusStats sum = busSim.total();
+  fprintf(stderr, "> sim %lu ms, %lu serial bytes, CE low %.1f us, BUSY_ waits %u, 6800 BUSY %u, 6800 writes lost %u\n",
+          millis(), hostSerialBytesOut, sum.ceLowCycles / (double)AVR_CYCLES_PER_US,
+          sum.leftBusyHits, sum.mpuBusy, sum.mpuWritesLost);
+}
+
+// ***** bench cases *****
+// each one is a single run, bytes is how many RAM bytes that run touches
+
+static unsigned int benchHexLineAddress = 0x0200;
+
+static void benchReadAddress(){
+  for (unsigned int address = 0x0100; address < 0x0200; address++) readAddress(address);
+}
+
+static void benchGameReadAddress(){
+  for (unsigned int address = 0x0100; address < 0x0200; address++) gameReadAddress(address);
+}
+
+static void benchWriteAddress(){
+  for (unsigned int address = 0x0100; address < 0x0200; address++) writeAddress(address, lowByte(address));
+}
+
+static void benchGameWriteAddress(){
+  for (unsigned int address = 0x0100; address < 0x0200; address++) gameWriteAddress(address, lowByte(address));
+}
+
+static void benchRefreshBuffer(){
+  refreshBuffer(0, ramSize);
+}
+
+static void benchGameRefreshBuffer(){
+  gameRefreshBuffer(0, ramSize);
+}
+
+static void benchFillRange(){
+  fillRange(0, ramSize, 0x55);
+}
+
+static void benchFillRandomRange(){
+  fillRandomRange(0, ramSize);
+}
+
+static void benchBdump(){
+  bdumpRange(0x0200, 16);
+}
+
+static void benchWatchPoll(){
+  watchClear();
+  watchAdd(0x00A0, 16);
+  watchAdd(0x0200, 16);
+  watchTimer = millis() - WATCH_INTERVAL_MS;
+  watchPoll();
+}
+
+static void benchDiffKeyframe(){
+  diffSetup(false, 0, ramSize, 0, 0);
+  diffValid = false;
+  diffFrame(true);
+}
+
+static void benchDiffDelta(){
+  diffSetup(false, 0, ramSize, 0, 0);
+  diffFrame(true);
+}
+
+static void benchHexLine(){
+  byte checkSum = 0x10 + highByte(benchHexLineAddress) + lowByte(benchHexLineAddress);
+  int length = sprintf(CommandLine, ":10%04X00", benchHexLineAddress);
+  for (byte i = 0; i < 0x10; i++) {
+    length += sprintf(CommandLine + length, "%02X", i);
+    checkSum += i;
+  }
+  sprintf(CommandLine + length, "%02X", (byte)(0x100 - checkSum));
+  DoMyHexLine(CommandLine, DataMode);
+  inputMode = CommandMode;
+}
+
+static void benchDumpCommand(){
+  strcpy(CommandLine, "dump 0x0200 16");
+  DoMyCommand(CommandLine);
+}
+
+struct BenchCase {
+  const char *name;
+  unsigned int bytes;
+  void (*run)();
+};
+
+static const BenchCase benchCases[] = {
+  { "readAddress x256",       256,  benchReadAddress },
+  { "gameReadAddress x256",   256,  benchGameReadAddress },
+  { "writeAddress x256",      256,  benchWriteAddress },
+  { "gameWriteAddress x256",  256,  benchGameWriteAddress },
+  { "refreshBuffer 2K",       2048, benchRefreshBuffer },
+  { "gameRefreshBuffer 2K",   2048, benchGameRefreshBuffer },
+  { "fillRange 2K",           2048, benchFillRange },
+  { "fillRandomRange 2K",     2048, benchFillRandomRange },
+  { "bdump 16",               16,   benchBdump },
+  { "watchPoll 2x16",         32,   benchWatchPoll },
+  { "diff keyframe 2K",       2048, benchDiffKeyframe },
+  { "diff delta 2K",          2048, benchDiffDelta },
+  { "DoMyHexLine 16",         16,   benchHexLine },
+  { "DoMyCommand dump 16",    16,   benchDumpCommand },
+};
+
+// ***** runBench *****
+static void runBench(int runs){
+  hostSerialMuted = true;
+  simReset();
+  setup();
+
+  printf("%-24s %6s %10s %9s %8s %9s %9s %10s %7s %7s %7s\n",
+         "routine", "bytes", "us/run", "ns/byte", "CE/run", "CE avg ns", "CE max ns", "CE us/run",
+         "BUSY_", "6800BSY", "6800WL");
+
+  for (const BenchCase &benchCase : benchCases) {
+    simReset();
+    uint64_t start = busSim.now;
+    for (int run = 0; run < runs; run++) benchCase.run();
+    uint64_t cycles = busSim.now - start;
+    BusStats sum = busSim.total();
+
+    double nsPerCycle = 1000.0 / AVR_CYCLES_PER_US;
+    double usPerRun = cycles / (double)runs / AVR_CYCLES_PER_US;
+    double windowsPerRun = sum.ceWindows / (double)runs;
+    double averageWindow = sum.ceWindows ? sum.ceLowCycles * nsPerCycle / sum.ceWindows : 0;
+
+    printf("%-24s %6u %10.1f %9.1f %8.0f %9.1f %9.1f %10.2f %7u %7u %7u\n",
+           benchCase.name, benchCase.bytes, usPerRun, usPerRun * 1000.0 / benchCase.bytes,
+           windowsPerRun, averageWindow, sum.ceLongestWindow * nsPerCycle,
+           sum.ceLowCycles / (double)runs / AVR_CYCLES_PER_US,
+           sum.leftBusyHits, sum.mpuBusy, sum.mpuWritesLost);
+  }
+  printf("\n%d runs each, 6800 %s at %d%% RAM load, seed %u\n", runs,
+         busSim.mpuEnabled ? "on" : "off", busSim.mpuLoadPercent, simSeed);
+  printf("BUSY_ = ATmega accesses held off by the 6800, 6800BSY = BUSY faults given to the 6800, 6800WL = 6800 writes lost\n");
+}
+
+static void usage(){
+  fprintf(stderr,
+    "usage: atmel_sim [--bench] [--runs n] [--seed n] [--mpu-load percent] [--no-mpu] [--load dumps/file.txt] [--run-ms ms]\n");
+}
+
+int main(int argc, char **argv){
+  bool bench = false;
+  int runs = DEFAULT_BENCH_RUNS;
+  unsigned long runMs = DEFAULT_RUN_MS;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = (i + 1 < argc);
+    if (arg == "--bench") bench = true;
+    else if (arg == "--no-mpu") busSim.mpuEnabled = false;
+    else if (arg == "--runs" && hasValue) runs = atoi(argv[++i]);
+    else if (arg == "--seed" && hasValue) simSeed = strtoul(argv[++i], NULL, 0);
+    else if (arg == "--mpu-load" && hasValue) busSim.mpuLoadPercent = atoi(argv[++i]);
+    else if (arg == "--run-ms" && hasValue) runMs = strtoul(argv[++i], NULL, 0);
+    else if (arg == "--load" && hasValue) {
+      dumpFile = argv[++i];
+      if (!loadDump(dumpFile)) {
+        fprintf(stderr, "can't read %s\n", dumpFile);
+        return 1;
+      }
+    }
+    else {
+      usage();
+      return 1;
+    }
+  }
+
+  if (bench) {
+    runBench(runs > 0 ? runs : 1);
+    return 0;
+  }
+
+  simReset();
+  runCommands(runMs);
+  return 0;
+}
@@ -15,12 +15,19 @@
 #include <LiquidCrystal_I2C.h>  // "LiquidCrystal I2C" by Frank de Brabander (Marco Schwartz) v1.1.2
 #include <ArduinoJson.h>        // v6.19.4
 #include <ElegantOTA.h>         // v2.2.9
+#include <LittleFS.h>
+#include <lwip/sockets.h>
+#include <MachineProfile.h>     // libraries/MachineProfile, game RAM layout shared with the ATmega
 //#include <WebSerial.h>          // v1.3.0
 
 #include "secrets.h"
 //#include "lets_encrypt_ca.h"
 
+#ifdef PORTAL_API_URL  // set in secrets.h to test against a stand-in, see tools/portal_standin.py
+String portalAPI = PORTAL_API_URL;
+#else
 String portalAPI = "https://api.my.protospace.ca";
+#endif
 //String portalAPI = "https://api.spaceport.dns.t0.vc";
 
 
@@ -36,21 +43,65 @@ String portalAPI = "https://api.my.protospace.ca";
 //HardwareSerial *gameSerial = &Serial;   	// for development use Serial 0 tied to USB gateway chip
 HardwareSerial* gameSerial = &Serial1;      // For game user communicate over Serial1 to Atmega2560 RX2 D17 / TX2 D16
 
-#define GAME_DATA_DELAY_MS 250
+#define WATCH_RESUBSCRIBE_MS 10000  // resend watch if the ATmega has been quiet this long, covers an ATmega reset
 #define CONTROLLER_DELAY_MS 1000
-#define BONUS_WAIT_TIME 1000
+// after game over the scores are sent once they stop changing. A bonus count changes them every few tens of
+// ms, so the quiet time needed is a few of the recent gaps between changes, within the limits below.
+#define BONUS_SETTLE_MIN_MS 150
+#define BONUS_SETTLE_MAX_MS 1500
+#define BONUS_SETTLE_GAPS 4
+#define BONUS_BURST_GAP_MS 250   // changes closer together than this are a count, further apart is normal play
+#define BONUS_WAIT_MAX_MS 15000  // send anyway if the scores never settle
+#define SAMPLE_TIMEOUT_MS 250  // give up waiting for an mdump reply and use the last pushed values
 #define CONNECT_TIMEOUT_MS 30000
 #define ELLIPSIS_ANIMATION_DELAY_MS 1000
 #define HEARTBEAT_INTERVAL_MS 1000 * 60 * 60  // hourly
-
-#define NUM_MAX_PLAYERS 4
+#define TASK_REPORT_INTERVAL_MS 1000 * 60      // loop() prints task loop latency this often
+
+// game RAM layout comes from machine in MachineProfile.h. machine.sampleRanges are watched and sampled
+// together so game state, player number and scores always come from the same read, and the ATmega
+// rereads the score block until it is stable and valid BCD.
+#define NUM_MAX_PLAYERS (machine.players)
+
+// binary frames sent by the ATmega mdump and watch commands:
+//   0xA5, type, length low, length high, payload[length], crc high, crc low
+// crc is CRC-16/CCITT-FALSE over type, length and payload
+#define FRAME_SYNC 0xA5
+#define FRAME_TYPE_SAMPLE 'M'  // payload is id, flags, range count, then per range address high, address low, count low, count high, data bytes
+#define FRAME_TYPE_STATS 'S'   // reply to stats, payload is a field count then that many 32 bit counters, low byte first
+#define SAMPLE_VALIDATED 0x01  // flag, the ATmega read the sample twice with the same result and the scores are valid BCD
+#define WATCH_SAMPLE_ID 0      // id of the samples watch pushes, mdump requests use 1 to 255
+
+// How often the ATmega re-reads the watched ranges, set by the controller for the game phase. Rarely while
+// the machine sits idle, which also keeps the ATmega off the RAM the 6800 is using, every 10 ms in play
+// and faster while the bonus counts after game over.
+#define SAMPLE_PHASE_IDLE 0
+#define SAMPLE_PHASE_PLAY 1
+#define SAMPLE_PHASE_BONUS 2
+static const unsigned int samplePhaseIntervalMs[] = { 250, 10, 4 };
+// the largest frame read is an M sample of machine.sampleRanges, which the ATmega also watches, so its data
+// fits the 64 byte WATCH_BUFFER_SIZE plus a few header bytes per range. Anything longer is a frame for
+// someone else, a bdump typed on the USB side, and is counted in frameErrors and skipped.
+#define FRAME_MAX_PAYLOAD 128
+// about 90 ms of input at 115200 baud while the ingest task is held off by the other tasks or a flash
+// write, the default of 256 is 22 ms. The portal requests run in their own task and don't stall it.
+#define GAME_SERIAL_RX_BUFFER 1024
+
+// serial input is assembled a byte at a time into fixed buffers, nothing in loop() waits for a timeout
+#define LINE_MAX_LENGTH 128
+
+// RFID reader sends STX, 10 card characters, checksum and line end characters, ETX
+#define RFID_STX 0x02
+#define RFID_ETX 0x03
+#define RFID_CARD_LENGTH 10
+#define RFID_FRAME_MAX 16
+#define REBOOT_CARD "0700B5612A"
 
 #define GAME_STATE_UNKNOWN -1
 #define GAME_STATE_IN_GAME 0
 #define GAME_STATE_IDLE 1
 #define GAME_STATE_SETTINGS 2
 static const char* gameStateLabels[] = { "IN GAME", "IDLE", "SETTINGS" };
-int gameState = GAME_STATE_UNKNOWN;
 
 #define PLAYER_UNKNOWN -1
 #define PLAYER1 0
@@ -59,18 +110,247 @@ int gameState = GAME_STATE_UNKNOWN;
 #define PLAYER4 3
 static const char* playerNumberLabels[] = { "PLAYER1", "PLAYER2", "PLAYER3", "PLAYER4" };
 static const char* playerNumberLabelsShort[] = { "P1", "P2", "P3", "P4" };
-int playerNumber = PLAYER_UNKNOWN;
+static_assert(NUM_MAX_PLAYERS <= 4, "player labels and the LCD layout are for up to 4 players");
+
+// game RAM decoded by the ingest task. The controller works from a copy taken with readGameSnapshot()
+// so a score update never waits on the controller, and the controller never sees half an update.
+struct GameSnapshot {
+	int gameState;
+	int playerNumber;
+	int totalScore;
+	int playerScores[NUM_MAX_PLAYERS];
+	unsigned long sequence;  // bumped whenever anything above changes, the web task streams on a new value
+};
+GameSnapshot sharedGame = { GAME_STATE_UNKNOWN, PLAYER_UNKNOWN, 0, {}, 0 };
+portMUX_TYPE gameLock = portMUX_INITIALIZER_UNLOCKED;
+
+// when the decoded scores last changed in any game state, for the controller to see the bonus settle.
+// Also under gameLock.
+struct ScoreActivity {
+	unsigned long changedMs;
+	unsigned long burstGapMs;  // average gap in the current run of quick changes, 0 outside one
+	int scores[NUM_MAX_PLAYERS];
+};
+ScoreActivity scoreActivity = {};
 
-int totalScore = 0;
-int playerScores[NUM_MAX_PLAYERS];
 String scannedCard = "";
 String playerCards[NUM_MAX_PLAYERS];
 String playerNames[NUM_MAX_PLAYERS];
 String playerDrinks[NUM_MAX_PLAYERS];
 
 WiFiClientSecure wc;
+WiFiClient plainClient;  // for an http:// PORTAL_API_URL
+
+// One HTTPClient for every portal request, only used by the http task. It keeps the connection open after
+// end() and reuses it when the next begin() is to the same host, so heartbeat, name lookups and score posts
+// share one TLS session instead of a handshake each. WiFiClientSecure has no session resumption API,
+// so when the portal drops the idle connection the next request pays for a full handshake.
+HTTPClient portalHttp;
+unsigned long portalConnects = 0;
+unsigned long portalReuses = 0;
 WebServer server(80);
 
+// The firmware runs as pinned FreeRTOS tasks, each one calling its step function in a loop:
+//   ingest      core 1  serial from the ATmega, USB and RFID, decodes game RAM into sharedGame
+//   controller  core 1  game state machine, never blocks on the network or the display
+//   http        core 0  portal requests from httpRequests, answers on httpResponses
+//   lcd         core 1  copies the LcdBuffer the controller draws into to the I2C display
+//   web         core 0  web server and OTA
+// WiFi runs on core 0, so the TLS work there doesn't hold up score capture on core 1.
+#define NAME_MAX_LENGTH 32
+#define GAME_ID_LENGTH 16
+#define HTTP_QUEUE_LENGTH 4
+#define HTTP_QUEUE_RESERVED 1  // slots card refreshes leave free for the controller's own requests
+#define HTTP_BEGIN_FAILED -1000  // result when https.begin fails, HTTPClient errors are -1 to -11
+#define HTTP_TASK_WAIT_MS 100
+#define HTTP_RESPONSE_TIMEOUT_MS 30000  // a TLS connect to a slow portal can take many seconds, then give up
+#define BATCH_SCORES false  // true sends every player of a game in one POST to /pinball/scores/, needs portal support
+#define SCORES_JSON_LENGTH 512
+
+// Scores go to an append-only journal in LittleFS at game end and the http task posts them from there,
+// so a portal or WiFi outage neither loses scores nor holds up the next game.
+#define JOURNAL_FILE "/scores.jnl"
+#define JOURNAL_SCORE 1  // a score to post
+#define JOURNAL_ACK 2    // the score with this sequence number was posted, or refused for good
+#define JOURNAL_RETRY_MIN_MS 5000
+#define JOURNAL_RETRY_MAX_MS 600000
+#define JOURNAL_MEMORY_SIZE 16  // scores kept in RAM when LittleFS is missing or an append failed
+#define CARD_QUEUE_LENGTH 2
+
+// Card number to name and drink, least recently scanned entry is evicted when full.
+// A hit is used right away, entries older than the TTL are looked up again in the background.
+#define CARD_CACHE_FILE "/cards.bin"
+#define CARD_CACHE_SIZE 64
+#define CARD_CACHE_VERSION 1
+#define CARD_CACHE_TTL_S (24 * 60 * 60)
+#define CARD_CACHE_SAVE_MS 600000  // scans only reorder entries, write that back at most this often
+
+enum httpRequestTypes {
+	HTTP_HEARTBEAT,
+	HTTP_GET_NAME,
+	HTTP_POST_SCORE,
+	HTTP_POST_SCORES,
+	HTTP_REFRESH_NAME,  // like HTTP_GET_NAME but only updates the card cache, no response to the controller
+	HTTP_REQUEST_TYPES,  // number of types, not a request
+};
+static const char* httpRequestNames[] = { "heartbeat", "get_name", "post_score", "post_scores", "refresh_name" };
+
+struct HttpRequest {
+	uint32_t id;  // from sendHttpRequest, copied to the response
+	enum httpRequestTypes type;
+	int player;
+	int score;
+	char card[RFID_CARD_LENGTH + 1];
+	char gameId[GAME_ID_LENGTH];
+	int scores[NUM_MAX_PLAYERS];                        // HTTP_POST_SCORES only
+	char cards[NUM_MAX_PLAYERS][RFID_CARD_LENGTH + 1];  // empty for unclaimed players
+};
+
+struct HttpResponse {
+	uint32_t id;
+	enum httpRequestTypes type;
+	int player;
+	int result;  // HTTP code, HTTPClient error or HTTP_BEGIN_FAILED
+	char name[NAME_MAX_LENGTH];
+	char drink[NAME_MAX_LENGTH];
+};
+
+QueueHandle_t httpRequests;
+QueueHandle_t httpResponses;
+uint32_t httpRequestId = 0;  // controller only
+QueueHandle_t cardQueue;  // card numbers from the ingest task to the controller
+
+struct JournalRecord {
+	uint8_t kind;
+	uint8_t player;
+	uint16_t crc;  // CRC-16/CCITT-FALSE over the record with crc set to 0
+	uint32_t sequence;
+	int32_t score;
+	char card[RFID_CARD_LENGTH + 1];
+	char gameId[GAME_ID_LENGTH];
+};
+
+struct CardCacheEntry {
+	char card[RFID_CARD_LENGTH + 1];  // empty for a free slot
+	char name[NAME_MAX_LENGTH];
+	char drink[NAME_MAX_LENGTH];
+	uint32_t fetched;   // epoch seconds of the last portal answer
+	uint32_t lastUsed;  // cardCacheClock at the last scan
+};
+
+struct CardCacheHeader {
+	uint16_t version;
+	uint16_t crc;  // CRC-16/CCITT-FALSE over the entries
+};
+
+// the controller looks cards up, the http task stores portal answers, cardCacheMutex guards both
+CardCacheEntry cardCache[CARD_CACHE_SIZE];
+SemaphoreHandle_t cardCacheMutex;
+uint32_t cardCacheClock = 0;
+bool cardCacheDirty = false;
+unsigned long cardCacheSaved = 0;
+unsigned long cardCacheHits = 0;
+unsigned long cardCacheMisses = 0;
+
+bool flashMounted = false;
+
+// Acks are written oldest first, so everything up to journalAcked has been posted.
+// The file is removed once nothing is pending. journalMutex guards the file and these counters,
+// the controller appends and the http task reads and acks.
+SemaphoreHandle_t journalMutex;
+bool journalReady = false;
+uint32_t journalLast = 0;          // sequence of the newest score record
+uint32_t journalAcked = 0;         // sequence of the newest acked score record
+size_t journalReadOffset = 0;      // no pending score record before this offset
+unsigned long journalRetryMs = JOURNAL_RETRY_MIN_MS;
+unsigned long journalNextTry = 0;
+// scores that could not be written are posted from here, oldest first, with sequence 0. They are lost on a reset.
+JournalRecord journalMemory[JOURNAL_MEMORY_SIZE];
+int journalMemoryCount = 0;
+
+struct PipelineTask {
+	const char* name;
+	void (*step)();
+	uint32_t stackSize;
+	UBaseType_t priority;
+	BaseType_t core;
+	TickType_t delayTicks;  // between steps, 0 when the step blocks on a queue itself
+	unsigned long lastStart;  // micros() at the start of the last step
+	unsigned long maxGap;     // longest time between two steps since the last report
+	unsigned long totalGap;
+	unsigned long steps;
+};
+portMUX_TYPE taskStatsLock = portMUX_INITIALIZER_UNLOCKED;
+
+#define LCD_COLUMNS 20
+#define LCD_ROWS 4
+#define LCD_FRAME_MS 50
+#define LCD_RUN_GAP 2  // unchanged cells re-sent to join two changed runs, about what a setCursor costs
+
+// The controller draws into this the same way it drew to the LCD, lcdStep() sends it to the display.
+// Text past the end of a row is dropped.
+class LcdBuffer : public Print {
+	public:
+		LcdBuffer() {
+			memset(text, ' ', sizeof(text));
+		}
+
+		void clear() {
+			portENTER_CRITICAL(&lock);
+			memset(text, ' ', sizeof(text));
+			column = 0;
+			row = 0;
+			dirty = true;
+			portEXIT_CRITICAL(&lock);
+		}
+
+		void setCursor(uint8_t newColumn, uint8_t newRow) {
+			portENTER_CRITICAL(&lock);
+			column = newColumn;
+			row = newRow < LCD_ROWS ? newRow : LCD_ROWS - 1;
+			portEXIT_CRITICAL(&lock);
+		}
+
+		size_t write(uint8_t c) override {
+			portENTER_CRITICAL(&lock);
+			if (column < LCD_COLUMNS) {
+				if (text[row][column] != c) {
+					text[row][column] = c;
+					dirty = true;
+				}
+				column++;
+			}
+			portEXIT_CRITICAL(&lock);
+			return 1;
+		}
+		using Print::write;
+
+		// copy the text if it changed since the last call
+		bool takeFrame(char frame[LCD_ROWS][LCD_COLUMNS + 1]) {
+			bool changed;
+
+			portENTER_CRITICAL(&lock);
+			changed = dirty;
+			if (dirty) {
+				for (int i = 0; i < LCD_ROWS; i++) {
+					memcpy(frame[i], text[i], LCD_COLUMNS);
+					frame[i][LCD_COLUMNS] = '\0';
+				}
+				dirty = false;
+			}
+			portEXIT_CRITICAL(&lock);
+
+			return changed;
+		}
+
+	private:
+		char text[LCD_ROWS][LCD_COLUMNS];
+		uint8_t column = 0;
+		uint8_t row = 0;
+		bool dirty = false;
+		portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+};
+
 //void recvMsg(uint8_t *data, size_t len){
 //	WebSerial.println("Received Data...");
 //	String d = "";
@@ -80,7 +360,38 @@ WebServer server(80);
 //	WebSerial.println(d);
 //}
 
-LiquidCrystal_I2C lcd(0x27, 20, 4);
+LiquidCrystal_I2C lcdDevice(0x27, LCD_COLUMNS, LCD_ROWS);
+LcdBuffer lcd;
+unsigned long lcdFrames = 0;       // frames where something changed
+unsigned long lcdCursorMoves = 0;
+unsigned long lcdCellsWritten = 0;
+
+// /events streams the game to spectator screens as server sent events. The ingest task only bumps
+// sharedGame.sequence, the web task turns the newest snapshot into one event and writes it to every
+// client, so capture never waits on a browser and a burst of changes goes out as its latest state.
+#define EVENT_MAX_CLIENTS 6         // lwIP has 10 sockets, the rest are for the portal, page loads and OTA
+#define EVENT_MIN_INTERVAL_MS 20    // changes closer together than this are coalesced
+#define EVENT_KEEPALIVE_MS 15000    // comment line while nothing changes, keeps proxies open and finds dead clients
+#define EVENT_MAX_LENGTH 192
+
+// spectator screen at /live, redraws on every event from /events
+static const char LIVE_PAGE[] PROGMEM = R"(<!DOCTYPE html>
+<html><head><meta name="viewport" content="width=device-width"><title>Pinball Wizard</title>
+<style>body{font:2em monospace;background:#000;color:#fc0}.up{color:#fff}</style></head>
+<body><div id="state">...</div><div id="scores"></div><script>
+var source = new EventSource("/events");
+source.addEventListener("game", function(e) {
+	var game = JSON.parse(e.data);
+	document.getElementById("state").textContent = game.state || "...";
+	document.getElementById("scores").innerHTML = game.scores.map(function(score, i) {
+		return "<div" + (game.player == i + 1 ? " class=up" : "") + ">P" + (i + 1) + " " + score + "</div>";
+	}).join("");
+});
+</script></body></html>
+)";
+WiFiClient eventClients[EVENT_MAX_CLIENTS];
+unsigned long eventsSent = 0;
+unsigned long eventClientsDropped = 0;  // closed, or too slow to take a whole event
 
 void rebootArduino() {
 	lcd.clear();
@@ -94,15 +405,15 @@ enum controllerStates {
 	CONTROLLER_WIFI_CONNECT,
 	CONTROLLER_GET_TIME,
 	CONTROLLER_HEARTBEAT,
+	CONTROLLER_HEARTBEAT_WAIT,
 	CONTROLLER_RESET,
 	CONTROLLER_IDLE,
 	CONTROLLER_IN_GAME,
 	CONTROLLER_GET_NAME,
+	CONTROLLER_GET_NAME_WAIT,
+	CONTROLLER_WAIT_FOR_BONUS_SAMPLE,
 	CONTROLLER_WAIT_FOR_BONUS,
-	CONTROLLER_WAIT_FOR_BONUS_DELAY,
 	CONTROLLER_SEND_SCORES,
-	CONTROLLER_SEND_RETRY,
-	CONTROLLER_SUCCESS,
 	CONTROLLER_DELAY,
 	CONTROLLER_WAIT,
 };
@@ -110,31 +421,631 @@ enum controllerStates controllerState = CONTROLLER_BEGIN;
 
 enum dataStates {
 	DATA_START,
-	DATA_GAME_INFO,
-	DATA_PLAYER_SCORES,
-	DATA_DELAY,
-	DATA_WAIT,
+	DATA_SUBSCRIBE,
+	DATA_WATCH,
 };
 enum dataStates dataState = DATA_START;
 
+enum frameStates {
+	FRAME_HUNT,
+	FRAME_TYPE,
+	FRAME_LENGTH_LOW,
+	FRAME_LENGTH_HIGH,
+	FRAME_PAYLOAD,
+	FRAME_SKIP,
+	FRAME_CRC_HIGH,
+	FRAME_CRC_LOW,
+};
+enum frameStates frameState = FRAME_HUNT;
+
+byte framePayload[FRAME_MAX_PAYLOAD];
+byte frameType;
+uint16_t frameLength;
+uint16_t frameIndex;
+uint32_t frameSkip;      // bytes left of a frame too long for framePayload, payload and CRC
+uint16_t frameCrc;
+uint16_t frameReceivedCrc;
+unsigned long frameErrors = 0;
+unsigned long lastGameFrameTime = 0;
+
+// the controller asks for a fresh sample by bumping sampleRequestId, the ingest task sends the mdump
+// and sets sampleReplyId once the reply with that id has been stored in sharedGame
+volatile uint8_t sampleRequestId = WATCH_SAMPLE_ID;
+volatile uint8_t sampleSentId = WATCH_SAMPLE_ID;
+volatile uint8_t sampleReplyId = WATCH_SAMPLE_ID;
+unsigned long sampleReplies = 0;
+unsigned long sampleTimeouts = 0;
+unsigned long sampleRejects = 0;  // samples without SAMPLE_VALIDATED, not stored
+unsigned long sampleSentMicros = 0;
+
+// the controller sets samplePhase, the ingest task sends watchinterval when it differs from what was sent
+volatile uint8_t samplePhase = SAMPLE_PHASE_IDLE;
+int samplePhaseSent = -1;  // -1 sends it again after a subscribe, an ATmega reset forgets it
+
+// /metrics in the Prometheus text format. Histograms have the same fixed buckets in microseconds and
+// only ever count up, metricsLock guards them since the ingest, lcd and http tasks all record.
+#define METRICS_BUCKETS 14
+static const unsigned long metricsBucketsUs[METRICS_BUCKETS] = {
+	100, 500, 1000, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000
+};
+#define METRICS_CHUNK 1024          // response is sent in pieces this size, it never exists whole
+#define ATMEGA_STATS_MS 10000       // how often the ingest task asks the ATmega for its counters
+#define ATMEGA_STATS_FIELDS 10
+
+struct Histogram {
+	unsigned long buckets[METRICS_BUCKETS + 1];  // the last one is +Inf
+	unsigned long count;
+	uint64_t sumUs;
+};
+
+portMUX_TYPE metricsLock = portMUX_INITIALIZER_UNLOCKED;
+Histogram sampleRoundTrip;                      // mdump sent to its reply decoded
+Histogram sampleDecode;                         // one sample frame decoded and stored in sharedGame
+Histogram scoreToLcd;                           // a changed score stored to the next frame sent to the LCD
+Histogram bonusSettle;                          // game over until the scores were taken as final
+Histogram httpLatency[HTTP_REQUEST_TYPES];      // including a reconnect when the kept connection was closed
+unsigned long httpFailures[HTTP_REQUEST_TYPES];
+unsigned long httpReconnects = 0;
+unsigned long httpQueueFull = 0;
+unsigned long httpTimeouts = 0;
+unsigned long journalRetries = 0;
+unsigned long scoreChangedMicros = 0;           // 0 when no score change is waiting for the LCD
+
+// the ATmega counters from its last stats frame, see statsFrame() in atmel.ino
+unsigned long atmegaStats[ATMEGA_STATS_FIELDS];
+unsigned long atmegaStatsTime = 0;              // millis() when they arrived, 0 before the first frame
+unsigned long atmegaStatsAsked = 0;
+static const char* atmegaStatsNames[ATMEGA_STATS_FIELDS] = {
+	"pinball_atmega_uptime_ms",
+	"pinball_atmega_busy_faults_total",
+	"pinball_atmega_shadow_faults_total",
+	"pinball_atmega_fault_log_dropped_total",
+	"pinball_atmega_busy_waits_total",
+	"pinball_atmega_validate_samples_total",
+	"pinball_atmega_validate_retries_total",
+	"pinball_atmega_validate_torn_total",
+	"pinball_atmega_validate_bad_bcd_total",
+	"pinball_atmega_validate_failed_total",
+};
+
+void metricsObserve(Histogram& histogram, unsigned long us) {
+	int bucket = 0;
+
+	while (bucket < METRICS_BUCKETS && us > metricsBucketsUs[bucket]) {
+		bucket++;
+	}
+
+	portENTER_CRITICAL(&metricsLock);
+	histogram.buckets[bucket]++;
+	histogram.count++;
+	histogram.sumUs += us;
+	portEXIT_CRITICAL(&metricsLock);
+}
+
+struct GameUpdate {
+	int gameState;     // GAME_STATE_UNKNOWN when not in the data
+	int playerNumber;  // PLAYER_UNKNOWN when not in the data
+	bool haveScores;
+	int scores[NUM_MAX_PLAYERS];
+};
+
+struct LineAssembler {
+	char text[LINE_MAX_LENGTH + 1];
+	int length;
+};
+LineAssembler gameLine;  // ASCII replies from the ATmega, between frames
+LineAssembler usbLine;   // commands typed on USB Serial, passed through to the ATmega
+
+char rfidFrame[RFID_FRAME_MAX + 1];
+int rfidLength = 0;
+bool rfidInFrame = false;
+
+
+GameSnapshot readGameSnapshot() {
+	GameSnapshot game;
+
+	portENTER_CRITICAL(&gameLock);
+	game = sharedGame;
+	portEXIT_CRITICAL(&gameLock);
+
+	return game;
+}
+
+ScoreActivity readScoreActivity() {
+	ScoreActivity activity;
+
+	portENTER_CRITICAL(&gameLock);
+	activity = scoreActivity;
+	portEXIT_CRITICAL(&gameLock);
+
+	return activity;
+}
+
+// controller: ask the ingest task for one mdump of machine.sampleRanges, returns the id to wait for
+uint8_t requestSample() {
+	uint8_t id = sampleRequestId + 1;
+
+	if (id == WATCH_SAMPLE_ID) {
+		id++;
+	}
+	sampleRequestId = id;
+	return id;
+}
+
+// true once the reply to id, or to a later request, has been stored
+bool sampleAnswered(uint8_t id) {
+	return (int8_t)(sampleReplyId - id) >= 0;
+}
+
+void resetGameSnapshot() {
+	portENTER_CRITICAL(&gameLock);
+	sharedGame.gameState = GAME_STATE_UNKNOWN;
+	sharedGame.playerNumber = PLAYER_UNKNOWN;
+	sharedGame.totalScore = 0;
+	for (int i = 0; i < NUM_MAX_PLAYERS; i++) {
+		sharedGame.playerScores[i] = 0;
+	}
+	sharedGame.sequence++;
+	portEXIT_CRITICAL(&gameLock);
+}
+
+// the controller has one request outstanding at a time and waits for its answer in a *_WAIT state.
+// Returns the id to wait for, 0 when the queue was full and nothing was sent.
+uint32_t sendHttpRequest(enum httpRequestTypes type, int player) {
+	HttpRequest request = {};
+
+	if (++httpRequestId == 0) {
+		httpRequestId++;
+	}
+	request.id = httpRequestId;
+	request.type = type;
+	request.player = player;
+	strlcpy(request.card, scannedCard.c_str(), sizeof(request.card));
+	if (xQueueSend(httpRequests, &request, 0) != pdTRUE) {
+		httpQueueFull++;
+		return 0;
+	}
+	return request.id;
+}
+
+uint16_t crc16Update(uint16_t crc, byte data) {
+	crc ^= (uint16_t)data << 8;
+	for (int bit = 0; bit < 8; bit++) {
+		if (crc & 0x8000) {
+			crc = (crc << 1) ^ 0x1021;
+		} else {
+			crc = crc << 1;
+		}
+	}
+	return crc;
+}
+
+uint16_t journalCrc(JournalRecord record) {
+	uint16_t crc = 0xFFFF;
+
+	record.crc = 0;
+	for (size_t i = 0; i < sizeof(record); i++) {
+		crc = crc16Update(crc, ((const byte*)&record)[i]);
+	}
+	return crc;
+}
+
+bool journalAppend(JournalRecord* records, int count) {
+	File file = LittleFS.open(JOURNAL_FILE, FILE_APPEND);
+
+	if (!file) {
+		return false;
+	}
+
+	for (int i = 0; i < count; i++) {
+		records[i].crc = journalCrc(records[i]);
+	}
+	size_t written = file.write((const uint8_t*)records, sizeof(JournalRecord) * count);
+	file.close();
+
+	return written == sizeof(JournalRecord) * count;
+}
+
+// read the journal left by the last boot. A record cut short by a reset is dropped and the
+// file rewritten with just the pending scores.
+void journalBegin() {
+	JournalRecord record;
+	bool damaged = false;
+
+	journalMutex = xSemaphoreCreateMutex();
+
+	if (!flashMounted) {
+		Serial.println("[JOURNAL] No filesystem, scores will not survive a reset.");
+		return;
+	}
+	journalReady = true;
+
+	File file = LittleFS.open(JOURNAL_FILE, FILE_READ);
+	if (!file) {
+		return;
+	}
+
+	while (file.read((uint8_t*)&record, sizeof(record)) == sizeof(record)) {
+		if (record.crc != journalCrc(record)) {
+			damaged = true;
+			break;
+		}
+		if (record.kind == JOURNAL_SCORE && record.sequence > journalLast) {
+			journalLast = record.sequence;
+		}
+		if (record.kind == JOURNAL_ACK && record.sequence > journalAcked) {
+			journalAcked = record.sequence;
+		}
+	}
+	damaged = damaged || file.available() > 0;
+	file.close();
+
+	if (damaged) {
+		Serial.println("[JOURNAL] Damaged record, keeping the pending scores before it.");
+		JournalRecord pending[NUM_MAX_PLAYERS];
+		int count = 0;
+		uint32_t kept = journalAcked;
+
+		LittleFS.rename(JOURNAL_FILE, JOURNAL_FILE ".old");
+		file = LittleFS.open(JOURNAL_FILE ".old", FILE_READ);
+		while (file.read((uint8_t*)&record, sizeof(record)) == sizeof(record) && record.crc == journalCrc(record)) {
+			if (record.kind == JOURNAL_SCORE && record.sequence > journalAcked) {
+				pending[count++] = record;
+				kept = record.sequence;
+			}
+			if (count == NUM_MAX_PLAYERS) {
+				journalAppend(pending, count);
+				count = 0;
+			}
+		}
+		file.close();
+		journalAppend(pending, count);
+		LittleFS.remove(JOURNAL_FILE ".old");
+		journalLast = kept;
+	}
+
+	if (journalLast > journalAcked) {
+		Serial.printf("[JOURNAL] %lu scores waiting to be sent.\n", (unsigned long)(journalLast - journalAcked));
+	} else {
+		LittleFS.remove(JOURNAL_FILE);
+		journalLast = journalAcked = 0;
+	}
+}
+
+// scores not posted yet, in the file and in memory
+unsigned long journalPending() {
+	xSemaphoreTake(journalMutex, portMAX_DELAY);
+	unsigned long pending = (journalLast - journalAcked) + journalMemoryCount;
+	xSemaphoreGive(journalMutex);
+	return pending;
+}
+
+// controller, game over: one record per claimed player. journalLast only moves once the records are
+// on file. When the append fails the file is left alone for the rest of this boot, a partly written
+// game in it is beyond journalLast and never read, and the records go to journalMemory instead.
+bool journalScores(const GameSnapshot& game, const String& gameId) {
+	JournalRecord records[NUM_MAX_PLAYERS];
+	int count = 0;
+	int kept = 0;
+	bool saved = true;
+
+	xSemaphoreTake(journalMutex, portMAX_DELAY);
+	for (int i = 0; i < NUM_MAX_PLAYERS; i++) {
+		if (playerCards[i].length() == 0) {
+			continue;
+		}
+
+		JournalRecord& record = records[count++];
+		memset(&record, 0, sizeof(record));
+		record.kind = JOURNAL_SCORE;
+		record.player = i;
+		record.sequence = journalLast + count;
+		record.score = game.playerScores[i];
+		strlcpy(record.card, playerCards[i].c_str(), sizeof(record.card));
+		strlcpy(record.gameId, gameId.c_str(), sizeof(record.gameId));
+	}
+
+	if (count > 0) {
+		saved = journalReady && journalAppend(records, count);
+		if (saved) {
+			journalLast += count;
+		} else {
+			journalReady = false;
+			for (int i = 0; i < count && journalMemoryCount < JOURNAL_MEMORY_SIZE; i++) {
+				records[i].sequence = 0;
+				journalMemory[journalMemoryCount++] = records[i];
+				kept++;
+			}
+		}
+		journalNextTry = millis();  // send now, don't wait out a backoff from the last outage
+		journalRetryMs = JOURNAL_RETRY_MIN_MS;
+	}
+	xSemaphoreGive(journalMutex);
+
+	if (saved) {
+		Serial.printf("[JOURNAL] Saved %d scores for game %s.\n", count, gameId.c_str());
+	} else {
+		Serial.printf("[JOURNAL] Not saved, %d of %d scores for game %s kept in RAM until posted.\n", kept, count, gameId.c_str());
+	}
+	return saved;
+}
+
+// http task: the oldest pending records, all from the same game, at most max of them. The file
+// comes first, journalMemory only holds games from after the file failed.
+int journalPeek(JournalRecord* records, int max) {
+	JournalRecord record;
+	int count = 0;
+
+	xSemaphoreTake(journalMutex, portMAX_DELAY);
+	File file = LittleFS.open(JOURNAL_FILE, FILE_READ);
+
+	if (file && journalLast > journalAcked) {
+		file.seek(journalReadOffset);
+		while (count < max && file.read((uint8_t*)&record, sizeof(record)) == sizeof(record)) {
+			if (record.kind != JOURNAL_SCORE || record.sequence <= journalAcked || record.sequence > journalLast) {
+				if (count == 0) {
+					journalReadOffset = file.position();
+				}
+				continue;
+			}
+			if (count > 0 && strcmp(record.gameId, records[0].gameId) != 0) {
+				break;
+			}
+			records[count++] = record;
+		}
+	}
+	if (file) {
+		file.close();
+	}
+	if (count == 0) {
+		while (count < max && count < journalMemoryCount) {
+			if (count > 0 && strcmp(journalMemory[count].gameId, journalMemory[0].gameId) != 0) {
+				break;
+			}
+			records[count] = journalMemory[count];
+			count++;
+		}
+	}
+	xSemaphoreGive(journalMutex);
+
+	return count;
+}
+
+// http task: the records from journalPeek are done. File records are acked up to the last one's
+// sequence and the file dropped when nothing is left, records from journalMemory leave its front.
+void journalAck(const JournalRecord* records, int count) {
+	JournalRecord ack = {};
+
+	ack.kind = JOURNAL_ACK;
+	ack.sequence = records[count - 1].sequence;
+
+	xSemaphoreTake(journalMutex, portMAX_DELAY);
+	if (ack.sequence == 0) {
+		journalMemoryCount -= count;
+		memmove(journalMemory, journalMemory + count, sizeof(JournalRecord) * journalMemoryCount);
+	} else {
+		journalAcked = ack.sequence;
+		if (journalAcked >= journalLast) {
+			LittleFS.remove(JOURNAL_FILE);
+			journalReadOffset = 0;
+		} else {
+			journalAppend(&ack, 1);
+		}
+	}
+	xSemaphoreGive(journalMutex);
+}
+
+uint16_t cardCacheCrc() {
+	uint16_t crc = 0xFFFF;
+
+	for (size_t i = 0; i < sizeof(cardCache); i++) {
+		crc = crc16Update(crc, ((const byte*)cardCache)[i]);
+	}
+	return crc;
+}
+
+// call with cardCacheMutex held
+void cardCacheSave() {
+	CardCacheHeader header;
+
+	cardCacheDirty = false;
+	cardCacheSaved = millis();
+
+	if (!flashMounted) {
+		return;
+	}
+
+	File file = LittleFS.open(CARD_CACHE_FILE, FILE_WRITE);
+	if (!file) {
+		Serial.println("[CARD] Cache save failed.");
+		return;
+	}
+
+	header.version = CARD_CACHE_VERSION;
+	header.crc = cardCacheCrc();
+	file.write((const uint8_t*)&header, sizeof(header));
+	file.write((const uint8_t*)cardCache, sizeof(cardCache));
+	file.close();
+}
+
+void cardCacheBegin() {
+	CardCacheHeader header;
+	int count = 0;
+
+	cardCacheMutex = xSemaphoreCreateMutex();
+	memset(cardCache, 0, sizeof(cardCache));
+
+	File file = flashMounted ? LittleFS.open(CARD_CACHE_FILE, FILE_READ) : File();
+	if (!file) {
+		return;
+	}
+
+	bool loaded = file.read((uint8_t*)&header, sizeof(header)) == sizeof(header)
+		&& header.version == CARD_CACHE_VERSION
+		&& file.read((uint8_t*)cardCache, sizeof(cardCache)) == sizeof(cardCache)
+		&& header.crc == cardCacheCrc();
+	file.close();
+
+	if (!loaded) {
+		Serial.println("[CARD] Cache file unreadable, starting empty.");
+		memset(cardCache, 0, sizeof(cardCache));
+		return;
+	}
+
+	for (int i = 0; i < CARD_CACHE_SIZE; i++) {
+		if (cardCache[i].card[0]) {
+			count++;
+			cardCacheClock = max(cardCacheClock, cardCache[i].lastUsed);
+		}
+	}
+	Serial.printf("[CARD] Loaded %d cached cards.\n", count);
+}
+
+// call with cardCacheMutex held
+int cardCacheFind(const char* card) {
+	for (int i = 0; i < CARD_CACHE_SIZE; i++) {
+		if (cardCache[i].card[0] && strcmp(cardCache[i].card, card) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+bool cardCacheStale(const CardCacheEntry& entry) {
+	uint32_t now = time(nullptr);
+
+	// before NTP has set the clock now is near zero, so everything counts as stale
+	return now < entry.fetched || now - entry.fetched > CARD_CACHE_TTL_S;
+}
+
+// controller: copy the entry for card into entry, false on a miss
+bool cardCacheLookup(const char* card, CardCacheEntry& entry) {
+	xSemaphoreTake(cardCacheMutex, portMAX_DELAY);
+	int slot = cardCacheFind(card);
+	if (slot >= 0) {
+		cardCache[slot].lastUsed = ++cardCacheClock;
+		cardCacheDirty = true;
+		entry = cardCache[slot];
+		cardCacheHits++;
+	} else {
+		cardCacheMisses++;
+	}
+	xSemaphoreGive(cardCacheMutex);
+
+	return slot >= 0;
+}
+
+// http task: store a portal answer, taking the least recently scanned slot for a new card
+void cardCacheStore(const char* card, const char* name, const char* drink) {
+	xSemaphoreTake(cardCacheMutex, portMAX_DELAY);
+	int slot = cardCacheFind(card);
+
+	if (slot < 0) {
+		slot = 0;
+		for (int i = 0; i < CARD_CACHE_SIZE; i++) {
+			if (!cardCache[i].card[0]) {
+				slot = i;
+				break;
+			}
+			if (cardCache[i].lastUsed < cardCache[slot].lastUsed) {
+				slot = i;
+			}
+		}
+		strlcpy(cardCache[slot].card, card, sizeof(cardCache[slot].card));
+		cardCache[slot].lastUsed = ++cardCacheClock;
+	}
+
+	strlcpy(cardCache[slot].name, name, sizeof(cardCache[slot].name));
+	strlcpy(cardCache[slot].drink, drink, sizeof(cardCache[slot].drink));
+	cardCache[slot].fetched = time(nullptr);
+	cardCacheSave();
+	xSemaphoreGive(cardCacheMutex);
+}
+
+// http task: the portal no longer knows this card
+void cardCacheForget(const char* card) {
+	xSemaphoreTake(cardCacheMutex, portMAX_DELAY);
+	int slot = cardCacheFind(card);
+	if (slot >= 0) {
+		memset(&cardCache[slot], 0, sizeof(cardCache[slot]));
+		cardCacheSave();
+	}
+	xSemaphoreGive(cardCacheMutex);
+}
+
+// http task, idle: write back the scan order now and then rather than on every scan
+void cardCacheFlush() {
+	xSemaphoreTake(cardCacheMutex, portMAX_DELAY);
+	if (cardCacheDirty && millis() - cardCacheSaved > CARD_CACHE_SAVE_MS) {  // overflow safe
+		cardCacheSave();
+	}
+	xSemaphoreGive(cardCacheMutex);
+}
+
+// answers to requests the controller gave up on are dropped here
+bool receiveHttpResponse(uint32_t id, HttpResponse& response) {
+	while (xQueueReceive(httpResponses, &response, 0) == pdTRUE) {
+		if (response.id == id) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void handleCard(const char* card, const GameSnapshot& game) {
+	if (strcmp(card, REBOOT_CARD) == 0) {
+		rebootArduino();
+	}
+
+	if (controllerState == CONTROLLER_IN_GAME && game.playerNumber >= 0) {
+		bool nameIsSet = playerNames[game.playerNumber].length() > 0;
+		bool hasSomeScore = game.playerScores[game.playerNumber] > 10000;
+
+		if (!nameIsSet && !hasSomeScore) {
+			CardCacheEntry entry;
+
+			scannedCard = card;
+
+			Serial.print("Card: ");
+			Serial.println(scannedCard);
+
+			if (!cardCacheLookup(card, entry)) {
+				controllerState = CONTROLLER_GET_NAME;
+				return;
+			}
+
+			playerNames[game.playerNumber] = entry.name;
+			playerDrinks[game.playerNumber] = entry.drink;
+			playerCards[game.playerNumber] = scannedCard;
+
+			// a stale hit is refreshed only while that leaves room, a skipped refresh is tried on the next scan
+			if (cardCacheStale(entry) && uxQueueSpacesAvailable(httpRequests) > HTTP_QUEUE_RESERVED) {
+				sendHttpRequest(HTTP_REFRESH_NAME, game.playerNumber);
+			}
+		}
+	}
+}
 
 void processControllerState() {
 	static unsigned long timer = millis();
 	static enum controllerStates nextControllerState;
-	static int statusCode;
-	static StaticJsonDocument<1024> jsonDoc;
-	static int retryCount;
 	static String gameId;
 	static int previousTotalScore;
+	static uint32_t httpId;
+	static uint8_t sampleId;
 
-	String response;
-	String postData;
-	bool failed;
+	GameSnapshot game = readGameSnapshot();
+	HttpResponse response;
+	ScoreActivity activity;
+	unsigned long settleMs;
 	time_t now;
 	struct tm timeinfo;
 	int i;
-	int result;
-	HTTPClient https;
+	char card[RFID_CARD_LENGTH + 1];
+
+	if (xQueueReceive(cardQueue, card, 0) == pdTRUE) {
+		handleCard(card, game);
+	}
 
 	switch (controllerState) {
 		case CONTROLLER_BEGIN:
@@ -213,10 +1124,29 @@ void processControllerState() {
 			lcd.clear();
 			lcd.print("CHECK PORTAL...");
 
-			result = https.begin(wc, portalAPI + "/stats/");
+			httpId = sendHttpRequest(HTTP_HEARTBEAT, 0);
+			if (httpId == 0) {
+				nextControllerState = CONTROLLER_HEARTBEAT;
+				controllerState = CONTROLLER_DELAY;
+				break;
+			}
+			timer = millis();
+			controllerState = CONTROLLER_HEARTBEAT_WAIT;
+			break;
 
-			if (!result) {
-				Serial.println("[WIFI] https.begin failed.");
+		case CONTROLLER_HEARTBEAT_WAIT:
+			if (!receiveHttpResponse(httpId, response)) {
+				if (millis() - timer > HTTP_RESPONSE_TIMEOUT_MS) {  // overflow safe
+					httpTimeouts++;
+					lcd.clear();
+					lcd.print("PORTAL TIMEOUT");
+					nextControllerState = WiFi.status() == WL_CONNECTED ? CONTROLLER_RESET : CONTROLLER_BEGIN;
+					controllerState = CONTROLLER_DELAY;
+				}
+				break;
+			}
+
+			if (response.result == HTTP_BEGIN_FAILED) {
 				lcd.clear();
 				lcd.print("CONNECTION ERROR");
 				nextControllerState = CONTROLLER_BEGIN;
@@ -224,16 +1154,12 @@ void processControllerState() {
 				break;
 			}
 
-			result = https.GET();
-
-			Serial.printf("[WIFI] Http code: %d\n", result);
-
-			if (result != HTTP_CODE_OK) {
-				Serial.printf("[WIFI] Portal GET failed, error:\n%s\n", https.errorToString(result).c_str());
+			if (response.result != HTTP_CODE_OK) {
 				lcd.clear();
 				lcd.print("BAD REQUEST: ");
-				lcd.print(result);
-				nextControllerState = CONTROLLER_BEGIN;
+				lcd.print(response.result);
+				// with WiFi up keep taking games, scores wait in the journal until the portal is back
+				nextControllerState = WiFi.status() == WL_CONNECTED ? CONTROLLER_RESET : CONTROLLER_BEGIN;
 				controllerState = CONTROLLER_DELAY;
 				break;
 			}
@@ -247,18 +1173,9 @@ void processControllerState() {
 			break;
 
 		case CONTROLLER_RESET:
-			gameState = GAME_STATE_UNKNOWN;
-			playerNumber = PLAYER_UNKNOWN;
+			resetGameSnapshot();
 			time(&now);
 			gameId = String(now);
-			retryCount = 0;
-
-			totalScore = 0;
-
-			playerScores[0] = 0;
-			playerScores[1] = 0;
-			playerScores[2] = 0;
-			playerScores[3] = 0;
 
 			previousTotalScore = 0;
 
@@ -278,6 +1195,7 @@ void processControllerState() {
 			playerDrinks[3] = "";
 
 			Serial.println("[GAME] Cleared game data.");
+			samplePhase = SAMPLE_PHASE_IDLE;
 
 			lcd.clear();
 			lcd.print("WAITING FOR    ");
@@ -289,11 +1207,12 @@ void processControllerState() {
 			break;
 
 		case CONTROLLER_IDLE:
-			if (gameState == GAME_STATE_IN_GAME) {
+			if (game.gameState == GAME_STATE_IN_GAME) {
 				time(&now);
 				gameId = String(now);
 				Serial.print("[GAME] Starting new game with ID: ");
 				Serial.println(gameId);
+				samplePhase = SAMPLE_PHASE_PLAY;
 
 				controllerState = CONTROLLER_IN_GAME;
 				break;
@@ -306,16 +1225,19 @@ void processControllerState() {
 			break;
 
 		case CONTROLLER_IN_GAME:
-			if (gameState == GAME_STATE_IDLE) {
+			if (game.gameState == GAME_STATE_IDLE) {
 				Serial.println("[GAME] Game over, sending scores...");
 				lcd.clear();
 				lcd.print("GAME OVER");
+				samplePhase = SAMPLE_PHASE_BONUS;
+				// don't decide on what was last pushed, wait for a read made after game over
+				sampleId = requestSample();
 				timer = millis();
-				controllerState = CONTROLLER_WAIT_FOR_BONUS;
+				controllerState = CONTROLLER_WAIT_FOR_BONUS_SAMPLE;
 				break;
 			}
 
-			if (previousTotalScore > 0 && totalScore == 0) {
+			if (previousTotalScore > 0 && game.totalScore == 0) {
 				Serial.println("[GAME] Game reset via start button detected, restarting...");
 				lcd.clear();
 				lcd.print("BUTTON RESET");
@@ -324,63 +1246,63 @@ void processControllerState() {
 				break;
 			}
 
-			previousTotalScore = totalScore;
+			previousTotalScore = game.totalScore;
 
-			if (playerNumber >= 0) {
+			if (game.playerNumber >= 0) {
 				lcd.setCursor(0, 0);
 
-				bool nameIsSet = playerNames[playerNumber].length() > 0;
+				bool nameIsSet = playerNames[game.playerNumber].length() > 0;
 				if (nameIsSet) {
-					lcd.print(playerNumberLabelsShort[playerNumber]);
+					lcd.print(playerNumberLabelsShort[game.playerNumber]);
 					lcd.print(" ");
-					lcd.print(playerNames[playerNumber]);
+					lcd.print(playerNames[game.playerNumber]);
 
-					for (int i = 3 + playerNames[playerNumber].length(); i < 20; i++) {
+					for (int i = 3 + playerNames[game.playerNumber].length(); i < 20; i++) {
 						lcd.print(" ");
 					}
 
 					lcd.setCursor(0, 1);
 					lcd.print("SCORE: ");
-					lcd.print(playerScores[playerNumber]);
+					lcd.print(game.playerScores[game.playerNumber]);
 					lcd.print("     ");  // safe length up to 10M
 
-					if (playerScores[playerNumber] >= 1000000) {
+					if (game.playerScores[game.playerNumber] >= 1000000) {
 						lcd.setCursor(0, 2);
 						lcd.print("Wow, you deserve a");
 						lcd.setCursor(0, 3);
 						lcd.print("cold ");
-						lcd.print(playerDrinks[playerNumber]);
+						lcd.print(playerDrinks[game.playerNumber]);
 						lcd.print("!");
 
-						for (int i = 6 + playerDrinks[playerNumber].length(); i < 20; i++) {
+						for (int i = 6 + playerDrinks[game.playerNumber].length(); i < 20; i++) {
 							lcd.print(" ");
 						}
-					} else if (playerScores[playerNumber] >= 100000) {
+					} else if (game.playerScores[game.playerNumber] >= 100000) {
 						lcd.setCursor(0, 2);
 						lcd.print("Play better with a");
 						lcd.setCursor(0, 3);
 						lcd.print("cold ");
-						lcd.print(playerDrinks[playerNumber]);
+						lcd.print(playerDrinks[game.playerNumber]);
 						lcd.print("!");
 
-						for (int i = 6 + playerDrinks[playerNumber].length(); i < 20; i++) {
+						for (int i = 6 + playerDrinks[game.playerNumber].length(); i < 20; i++) {
 							lcd.print(" ");
 						}
 					} else {
 						lcd.setCursor(0, 2);
 						lcd.print("How about a cold  ");
 						lcd.setCursor(0, 3);
-						lcd.print(playerDrinks[playerNumber]);
+						lcd.print(playerDrinks[game.playerNumber]);
 						lcd.print("?");
 
-						for (int i = 1 + playerDrinks[playerNumber].length(); i < 20; i++) {
+						for (int i = 1 + playerDrinks[game.playerNumber].length(); i < 20; i++) {
 							lcd.print(" ");
 						}
 					}
 				} else {
-					lcd.print(playerNumberLabels[playerNumber]);
+					lcd.print(playerNumberLabels[game.playerNumber]);
 
-					if (playerScores[playerNumber] <= 10000) {
+					if (game.playerScores[game.playerNumber] <= 10000) {
 						lcd.print(" SCAN NOW         ");
 					} else {
 						lcd.print("                  ");
@@ -388,7 +1310,7 @@ void processControllerState() {
 
 					lcd.setCursor(0, 1);
 					lcd.print("SCORE: ");
-					lcd.print(playerScores[playerNumber]);
+					lcd.print(game.playerScores[game.playerNumber]);
 					lcd.print("     ");  // safe length up to 10M
 
 					lcd.setCursor(0, 2);
@@ -404,10 +1326,31 @@ void processControllerState() {
 			lcd.clear();
 			lcd.print("CHECKING CARD       ");
 
-			result = https.begin(wc, portalAPI + "/pinball/" + scannedCard + "/get_name/");
+			httpId = sendHttpRequest(HTTP_GET_NAME, game.playerNumber);
+			if (httpId == 0) {
+				lcd.setCursor(0, 1);
+				lcd.print("BUSY, SCAN AGAIN");
+				nextControllerState = CONTROLLER_IN_GAME;
+				controllerState = CONTROLLER_DELAY;
+				break;
+			}
+			timer = millis();
+			controllerState = CONTROLLER_GET_NAME_WAIT;
+			break;
 
-			if (!result) {
-				Serial.println("[CARD] https.begin failed.");
+		case CONTROLLER_GET_NAME_WAIT:
+			if (!receiveHttpResponse(httpId, response)) {
+				if (millis() - timer > HTTP_RESPONSE_TIMEOUT_MS) {  // overflow safe
+					httpTimeouts++;
+					lcd.clear();
+					lcd.print("SCAN TIMEOUT");
+					nextControllerState = CONTROLLER_IN_GAME;
+					controllerState = CONTROLLER_DELAY;
+				}
+				break;
+			}
+
+			if (response.result == HTTP_BEGIN_FAILED) {
 				lcd.clear();
 				lcd.print("CONNECTION ERROR");
 				nextControllerState = CONTROLLER_HEARTBEAT;
@@ -415,287 +1358,1066 @@ void processControllerState() {
 				break;
 			}
 
-			https.addHeader("Authorization", PINBALL_API_TOKEN);
-			result = https.GET();
-
-			Serial.printf("[CARD] Http code: %d\n", result);
-
-			if (result != HTTP_CODE_OK) {
-				Serial.printf("[CARD] Bad scan, error:\n%s\n", https.errorToString(result).c_str());
+			if (response.result != HTTP_CODE_OK) {
 				lcd.clear();
 				lcd.print("BAD SCAN: ");
-				lcd.print(result);
+				lcd.print(response.result);
 				nextControllerState = CONTROLLER_IN_GAME;
 				controllerState = CONTROLLER_DELAY;
 				break;
 			}
 
-			response = https.getString();
-
-			Serial.print("[CARD] Response: ");
-			Serial.println(response);
+			playerNames[response.player] = response.name;
+			playerDrinks[response.player] = response.drink;
+			playerCards[response.player] = scannedCard;
 
-			deserializeJson(jsonDoc, response);
+			controllerState = CONTROLLER_IN_GAME;
+			break;
 
-			playerNames[playerNumber] = jsonDoc["name"].as<String>();
-			playerDrinks[playerNumber] = jsonDoc["drink"].as<String>();
-			playerCards[playerNumber] = scannedCard;
+		case CONTROLLER_WAIT_FOR_BONUS_SAMPLE:
+			if (sampleAnswered(sampleId)) {
+				controllerState = CONTROLLER_WAIT_FOR_BONUS;
+			} else if (millis() - timer > SAMPLE_TIMEOUT_MS) {  // overflow safe
+				sampleTimeouts++;
+				controllerState = CONTROLLER_WAIT_FOR_BONUS;
+			}
 
-			controllerState = CONTROLLER_IN_GAME;
 			break;
 
 		case CONTROLLER_WAIT_FOR_BONUS:
-			if (totalScore == previousTotalScore) {
+			activity = readScoreActivity();
+			settleMs = min(max(activity.burstGapMs * BONUS_SETTLE_GAPS, (unsigned long)BONUS_SETTLE_MIN_MS),
+				(unsigned long)BONUS_SETTLE_MAX_MS);
+
+			// quiet since the last change or game over, whichever was later, a change from play doesn't count
+			if (min(millis() - activity.changedMs, millis() - timer) > settleMs
+				|| millis() - timer > BONUS_WAIT_MAX_MS) {  // overflow safe
+				metricsObserve(bonusSettle, (millis() - timer) * 1000);
 				controllerState = CONTROLLER_SEND_SCORES;
-				break;
 			}
-			previousTotalScore = totalScore;
 
-			controllerState = CONTROLLER_WAIT_FOR_BONUS_DELAY;
 			break;
 
-		case CONTROLLER_WAIT_FOR_BONUS_DELAY:
-			if (millis() - timer > BONUS_WAIT_TIME) {  // overflow safe
-				controllerState = CONTROLLER_WAIT_FOR_BONUS;
+		case CONTROLLER_SEND_SCORES:
+			lcd.clear();
+			if (journalScores(game, gameId)) {
+				lcd.print("SCORES SAVED!");
+			} else {
+				lcd.print("SCORE SAVE FAILED");
 			}
 
+			nextControllerState = CONTROLLER_RESET;
+			controllerState = CONTROLLER_DELAY;
 			break;
 
-		case CONTROLLER_SEND_SCORES:
-			failed = false;
-			for (i = 0; i < NUM_MAX_PLAYERS; i++) {
-				bool playerUnclaimed = playerCards[i].length() == 0;
-				if (playerUnclaimed) {
-					continue;
-				}
+		case CONTROLLER_DELAY:
+			timer = millis();
+			controllerState = CONTROLLER_WAIT;
+			break;
+
+		case CONTROLLER_WAIT:
+			if (millis() - timer > CONTROLLER_DELAY_MS) {  // overflow safe
+				controllerState = nextControllerState;
+			}
+			break;
+	}
 
-				result = https.begin(wc, portalAPI + "/pinball/score/");
+	return;
+}
 
-				if (!result) {
-					Serial.println("[SCORE] https.begin failed.");
-					lcd.clear();
-					lcd.print("CONNECTION ERROR");
-					nextControllerState = CONTROLLER_SEND_RETRY;
-					controllerState = CONTROLLER_DELAY;
-					failed = true;
-					break;
-				}
+WiFiClient& portalClient() {
+	if (portalAPI.startsWith("https")) {
+		return wc;
+	}
+	return plainClient;
+}
 
-				postData = "card_number="
-					+ playerCards[i]
-					+ "&game_id="
-					+ gameId
-					+ "&player="
-					+ String(i + 1)
-					+ "&score="
-					+ String(playerScores[i]);
+bool portalBegin(const String& path) {
+	WiFiClient& client = portalClient();
 
-				Serial.println("[SCORE] POST data:");
-				Serial.println(postData);
+	if (client.connected()) {
+		portalReuses++;
+	} else {
+		portalConnects++;
+	}
 
-				https.addHeader("Content-Type", "application/x-www-form-urlencoded");
-				https.addHeader("Content-Length", String(postData.length()));
-				https.addHeader("Authorization", PINBALL_API_TOKEN);
-				result = https.POST(postData);
+	return portalHttp.begin(client, portalAPI + path);
+}
 
-				Serial.printf("[SCORE] Http code: %d\n", result);
+// {"game_id":"...","scores":[{"player":1,"card_number":"...","score":123},...]} for claimed players
+void buildScoresJson(const HttpRequest& request, char* json, int size) {
+	int length = snprintf(json, size, "{\"game_id\":\"%s\",\"scores\":[", request.gameId);
+	bool first = true;
 
-				if (result != HTTP_CODE_OK) {
-					Serial.printf("[SCORE] Bad send, error:\n%s\n", https.errorToString(result).c_str());
-					lcd.clear();
-					lcd.print("BAD SEND: ");
-					lcd.print(result);
-					nextControllerState = CONTROLLER_SEND_RETRY;
-					controllerState = CONTROLLER_DELAY;
-					failed = true;
-					break;
-				}
-			}
+	for (int i = 0; i < NUM_MAX_PLAYERS && length < size; i++) {
+		if (request.cards[i][0] == '\0') {
+			continue;
+		}
+		length += snprintf(json + length, size - length, "%s{\"player\":%d,\"card_number\":\"%s\",\"score\":%d}",
+			first ? "" : ",", i + 1, request.cards[i], request.scores[i]);
+		first = false;
+	}
+
+	if (length < size) {
+		snprintf(json + length, size - length, "]}");
+	}
+}
+
+// runs in the http task, blocking here only holds up the http task
+int performHttpRequest(const HttpRequest& request, HttpResponse& response) {
+	static StaticJsonDocument<1024> jsonDoc;
+	static char scoresJson[SCORES_JSON_LENGTH];
+	String postData;
+	int result = HTTP_BEGIN_FAILED;
 
-			if (!failed) {
-				controllerState = CONTROLLER_SUCCESS;
+	switch (request.type) {
+		case HTTP_HEARTBEAT:
+			if (!portalBegin("/stats/")) {
+				Serial.println("[WIFI] https.begin failed.");
+				break;
 			}
 
+			result = portalHttp.GET();
+
+			Serial.printf("[WIFI] Http code: %d\n", result);
+
+			if (result != HTTP_CODE_OK) {
+				Serial.printf("[WIFI] Portal GET failed, error:\n%s\n", portalHttp.errorToString(result).c_str());
+			}
 			break;
 
-		case CONTROLLER_SEND_RETRY:
-			if (retryCount >= 5) {
-				lcd.clear();
-				lcd.print("SEND FAILED");
-				lcd.setCursor(0, 1);
-				lcd.print("RESETTING...");
-				nextControllerState = CONTROLLER_HEARTBEAT;
-				controllerState = CONTROLLER_DELAY;
+		case HTTP_GET_NAME:
+		case HTTP_REFRESH_NAME:
+			if (!portalBegin(String("/pinball/") + request.card + "/get_name/")) {
+				Serial.println("[CARD] https.begin failed.");
 				break;
 			}
 
-			retryCount++;
+			portalHttp.addHeader("Authorization", PINBALL_API_TOKEN);
+			result = portalHttp.GET();
 
-			lcd.clear();
-			lcd.print("RETRYING ");
-			lcd.print(retryCount);
-			lcd.print(" / 5");
+			Serial.printf("[CARD] Http code: %d\n", result);
+
+			if (result != HTTP_CODE_OK) {
+				Serial.printf("[CARD] Bad scan, error:\n%s\n", portalHttp.errorToString(result).c_str());
+				break;
+			}
 
-			Serial.print("[GAME] Retrying ");
-			Serial.print(retryCount);
-			Serial.println(" / 5...");
+			postData = portalHttp.getString();
 
-			controllerState = CONTROLLER_SEND_SCORES;
-			break;
+			Serial.print("[CARD] Response: ");
+			Serial.println(postData);
 
-		case CONTROLLER_SUCCESS:
-			lcd.clear();
-			lcd.print("SCORES SENT!");
+			deserializeJson(jsonDoc, postData);
 
-			nextControllerState = CONTROLLER_HEARTBEAT;
-			controllerState = CONTROLLER_DELAY;
+			strlcpy(response.name, jsonDoc["name"] | "", sizeof(response.name));
+			strlcpy(response.drink, jsonDoc["drink"] | "", sizeof(response.drink));
+			cardCacheStore(request.card, response.name, response.drink);
 			break;
 
-		case CONTROLLER_DELAY:
-			timer = millis();
-			controllerState = CONTROLLER_WAIT;
+		case HTTP_POST_SCORE:
+			if (!portalBegin("/pinball/score/")) {
+				Serial.println("[SCORE] https.begin failed.");
+				break;
+			}
+
+			postData = String("card_number=")
+				+ request.card
+				+ "&game_id="
+				+ request.gameId
+				+ "&player="
+				+ String(request.player + 1)
+				+ "&score="
+				+ String(request.score);
+
+			Serial.println("[SCORE] POST data:");
+			Serial.println(postData);
+
+			portalHttp.addHeader("Content-Type", "application/x-www-form-urlencoded");
+			portalHttp.addHeader("Content-Length", String(postData.length()));
+			portalHttp.addHeader("Authorization", PINBALL_API_TOKEN);
+			result = portalHttp.POST(postData);
+
+			Serial.printf("[SCORE] Http code: %d\n", result);
+
+			if (result != HTTP_CODE_OK) {
+				Serial.printf("[SCORE] Bad send, error:\n%s\n", portalHttp.errorToString(result).c_str());
+			}
 			break;
 
-		case CONTROLLER_WAIT:
-			if (millis() - timer > CONTROLLER_DELAY_MS) {  // overflow safe
-				controllerState = nextControllerState;
+		case HTTP_POST_SCORES:
+			if (!portalBegin("/pinball/scores/")) {
+				Serial.println("[SCORE] https.begin failed.");
+				break;
 			}
+
+			buildScoresJson(request, scoresJson, sizeof(scoresJson));
+
+			Serial.println("[SCORE] POST batch:");
+			Serial.println(scoresJson);
+
+			portalHttp.addHeader("Content-Type", "application/json");
+			portalHttp.addHeader("Authorization", PINBALL_API_TOKEN);
+			result = portalHttp.POST((uint8_t*)scoresJson, strlen(scoresJson));
+
+			Serial.printf("[SCORE] Http code: %d\n", result);
+
+			if (result != HTTP_CODE_OK) {
+				Serial.printf("[SCORE] Bad send, error:\n%s\n", portalHttp.errorToString(result).c_str());
+			}
+			break;
+
+		case HTTP_REQUEST_TYPES:
 			break;
 	}
 
-	return;
+	portalHttp.end();  // keeps the connection for the next request
+	return result;
 }
 
-void processDataState() {
-	static enum dataStates nextDataState;
-	static unsigned long timer;
+// errors where the request never reached the portal, safe to send again
+bool requestNotSent(int result) {
+	return result == HTTPC_ERROR_CONNECTION_REFUSED
+		|| result == HTTPC_ERROR_SEND_HEADER_FAILED
+		|| result == HTTPC_ERROR_SEND_PAYLOAD_FAILED
+		|| result == HTTPC_ERROR_NOT_CONNECTED;
+}
+
+int sendHttpRequestNow(const HttpRequest& request, HttpResponse& response) {
+	unsigned long start = micros();
+	bool reused = portalClient().connected();
+	int result = performHttpRequest(request, response);
+
+	if (reused && requestNotSent(result)) {
+		// the portal closed the kept connection while we were idle, once more on a new connection
+		Serial.println("[HTTP] Kept connection was closed, reconnecting.");
+		portalClient().stop();
+		httpReconnects++;
+		result = performHttpRequest(request, response);
+	}
+
+	metricsObserve(httpLatency[request.type], micros() - start);
+	if (result != HTTP_CODE_OK) {
+		httpFailures[request.type]++;
+	}
+	return result;
+}
+
+// the portal rejected the score itself, sending it again can't succeed and would block the journal.
+// Anything else, 401, 403 and 404 included, can be fixed on the portal side and is tried again.
+bool scoreRefused(int result) {
+	return result == 400 || result == 409 || result == 422;
+}
+
+// post the oldest journal entries, backing off while the portal or WiFi is down
+void drainJournal() {
+	JournalRecord records[NUM_MAX_PLAYERS];
+	HttpRequest request = {};
+	HttpResponse response = {};
+
+	if (journalPending() == 0 || (long)(millis() - journalNextTry) < 0 || WiFi.status() != WL_CONNECTED) {
+		return;
+	}
+
+	int count = journalPeek(records, BATCH_SCORES ? NUM_MAX_PLAYERS : 1);
+	if (count == 0) {
+		return;
+	}
+
+	if (BATCH_SCORES) {
+		request.type = HTTP_POST_SCORES;
+		for (int i = 0; i < count; i++) {
+			request.scores[records[i].player] = records[i].score;
+			strlcpy(request.cards[records[i].player], records[i].card, sizeof(request.cards[0]));
+		}
+	} else {
+		request.type = HTTP_POST_SCORE;
+		request.player = records[0].player;
+		request.score = records[0].score;
+		strlcpy(request.card, records[0].card, sizeof(request.card));
+	}
+	strlcpy(request.gameId, records[0].gameId, sizeof(request.gameId));
+
+	int result = sendHttpRequestNow(request, response);
+
+	if (result == HTTP_CODE_OK || scoreRefused(result)) {
+		if (result != HTTP_CODE_OK) {
+			Serial.printf("[JOURNAL] Portal refused game %s with %d, dropping it.\n", records[0].gameId, result);
+		}
+		journalAck(records, count);
+		journalRetryMs = JOURNAL_RETRY_MIN_MS;
+		journalNextTry = millis();
+		return;
+	}
+
+	journalNextTry = millis() + journalRetryMs;
+	journalRetries++;
+	Serial.printf("[JOURNAL] Send failed, %lu pending, next try in %lu s.\n",
+		journalPending(), journalRetryMs / 1000);
+	journalRetryMs = min(journalRetryMs * 2, (unsigned long)JOURNAL_RETRY_MAX_MS);
+}
 
+void httpStep() {
+	HttpRequest request;
+	HttpResponse response = {};
+
+	if (xQueueReceive(httpRequests, &request, pdMS_TO_TICKS(HTTP_TASK_WAIT_MS)) != pdTRUE) {
+		drainJournal();  // only when the controller isn't waiting on us
+		cardCacheFlush();
+		return;
+	}
+
+	response.id = request.id;
+	response.type = request.type;
+	response.player = request.player;
+	response.result = sendHttpRequestNow(request, response);
+
+	if (request.type == HTTP_REFRESH_NAME) {
+		if (response.result == HTTP_CODE_NOT_FOUND) {
+			cardCacheForget(request.card);
+		}
+		return;  // a stale hit was already used, nobody is waiting for this
+	}
+
+	xQueueSend(httpResponses, &response, portMAX_DELAY);
+}
+
+// the ATmega pushes game info and scores whenever they change, so there is nothing to poll
+// the controller can still ask for a sample when it needs values no older than its request
+void processDataState() {
 	switch (dataState) {
 		case DATA_START:
-			dataState = DATA_GAME_INFO;
+			dataState = DATA_SUBSCRIBE;
 			break;
 
-		case DATA_GAME_INFO:
-			Serial.println("Getting game state and player number...");
-			gameSerial->println("dump 160 16");
-			nextDataState = DATA_PLAYER_SCORES;
-			dataState = DATA_DELAY;
+		case DATA_SUBSCRIBE:
+			Serial.println("Watching game state, player number and scores...");
+			gameSerial->printf("validate on 0x%04X %u\n", machine.scoreAddress, profileScoreBlock(machine));
+			gameSerial->print("watch ");
+			gameSerial->println(machine.sampleRanges);
+			samplePhaseSent = -1;
+			lastGameFrameTime = millis();
+			dataState = DATA_WATCH;
 			break;
 
-		case DATA_PLAYER_SCORES:
-			Serial.println("Getting player scores...");
-			gameSerial->println("dump 0x0200 16");
-			nextDataState = DATA_GAME_INFO;
-			dataState = DATA_DELAY;
+		case DATA_WATCH:
+			if (millis() - lastGameFrameTime > WATCH_RESUBSCRIBE_MS) {  // overflow safe
+				dataState = DATA_SUBSCRIBE;
+			}
+
+			if (samplePhase != samplePhaseSent) {
+				samplePhaseSent = samplePhase;
+				gameSerial->printf("watchinterval %u\n", samplePhaseIntervalMs[samplePhaseSent]);
+			}
+
+			if (millis() - atmegaStatsAsked > ATMEGA_STATS_MS) {  // overflow safe
+				atmegaStatsAsked = millis();
+				gameSerial->println("stats");
+			}
+
+			if (sampleSentId != sampleRequestId) {
+				char command[LINE_MAX_LENGTH];
+
+				sampleSentId = sampleRequestId;
+				sampleSentMicros = micros();
+				snprintf(command, sizeof(command), "mdump %d %s", sampleSentId, machine.sampleRanges);
+				gameSerial->println(command);
+			}
 			break;
+	}
+}
 
+int decodeBcd(const byte* data, int count) {
+	int value = 0;
 
-		case DATA_DELAY:
-			timer = millis();
-			dataState = DATA_WAIT;
+	for (int i = 0; i < count; i++) {
+		value = value * 100 + (data[i] >> 4) * 10 + (data[i] & 0x0F);
+	}
+
+	return value;
+}
+
+// decode a block of game RAM starting at address into update, fields outside the block are left alone
+void decodeGameData(unsigned int address, const byte* data, int count, GameUpdate& update) {
+	if (profileCovers(machine.stateAddress, 1, address, count)) {
+		byte state = data[machine.stateAddress - address] & machine.stateMask;
+
+		if (state == machine.stateInGame) {
+			update.gameState = GAME_STATE_IN_GAME;
+		} else if (state == machine.stateIdle) {
+			update.gameState = GAME_STATE_IDLE;
+		} else if (state == machine.stateSettings) {
+			update.gameState = GAME_STATE_SETTINGS;
+		}
+	}
+
+	if (profileCovers(machine.playerAddress, 1, address, count)) {
+		int num = (data[machine.playerAddress - address] & machine.playerMask) - machine.playerFirst;
+
+		if (num >= 0 && num < NUM_MAX_PLAYERS) {
+			update.playerNumber = num;
+		}
+	}
+
+	if (profileCovers(machine.scoreAddress, profileScoreBlock(machine), address, count)) {
+		for (int i = 0; i < NUM_MAX_PLAYERS; i++) {
+			update.scores[i] = decodeBcd(data + profileScoreAddress(machine, i) - address, machine.scoreBytes);
+		}
+		update.haveScores = true;
+	}
+}
+
+// runs in the ingest task, everything in update is stored under one hold of gameLock
+void storeGameUpdate(const GameUpdate& update) {
+	bool scoresSet = false;
+
+	portENTER_CRITICAL(&gameLock);
+	GameSnapshot before = sharedGame;
+	if (update.gameState != GAME_STATE_UNKNOWN) {
+		sharedGame.gameState = update.gameState;
+	}
+	if (update.playerNumber != PLAYER_UNKNOWN) {
+		sharedGame.playerNumber = update.playerNumber;
+	}
+	if (update.haveScores && memcmp(update.scores, scoreActivity.scores, sizeof(update.scores)) != 0) {
+		unsigned long gap = millis() - scoreActivity.changedMs;
+
+		if (gap > BONUS_BURST_GAP_MS) {
+			scoreActivity.burstGapMs = 0;
+		} else if (scoreActivity.burstGapMs == 0) {
+			scoreActivity.burstGapMs = gap;
+		} else {
+			scoreActivity.burstGapMs = (scoreActivity.burstGapMs * 3 + gap) / 4;
+		}
+		scoreActivity.changedMs = millis();
+		memcpy(scoreActivity.scores, update.scores, sizeof(update.scores));
+	}
+	// the bonus may still be counting after the game state went idle
+	if (update.haveScores && (sharedGame.gameState == GAME_STATE_IN_GAME || samplePhase == SAMPLE_PHASE_BONUS)) {
+		int tmpTotalScore = 0;
+
+		for (int i = 0; i < NUM_MAX_PLAYERS; i++) {
+			if (update.scores[i] != 0) {  // prevent button reset nuking scores before send
+				sharedGame.playerScores[i] = update.scores[i];
+			}
+			tmpTotalScore += update.scores[i];
+		}
+
+		sharedGame.totalScore = tmpTotalScore;
+		scoresSet = true;
+	}
+	if (memcmp(&before, &sharedGame, sizeof(GameSnapshot)) != 0) {
+		sharedGame.sequence++;
+	}
+	bool scoresChanged = memcmp(before.playerScores, sharedGame.playerScores, sizeof(before.playerScores)) != 0;
+	portEXIT_CRITICAL(&gameLock);
+
+	if (scoresChanged) {
+		portENTER_CRITICAL(&metricsLock);
+		if (scoreChangedMicros == 0) {
+			scoreChangedMicros = micros() | 1;  // never 0
+		}
+		portEXIT_CRITICAL(&metricsLock);
+	}
+
+	if (update.gameState != GAME_STATE_UNKNOWN) {
+		Serial.print("Set gamestate: ");
+		Serial.println(gameStateLabels[update.gameState]);
+	}
+
+	if (update.playerNumber != PLAYER_UNKNOWN) {
+		Serial.print("Set player number: ");
+		Serial.println(playerNumberLabels[update.playerNumber]);
+	}
+
+	if (scoresSet) {
+		Serial.println("Set player scores.");
+	}
+}
+
+GameUpdate emptyGameUpdate() {
+	GameUpdate update = {};
+
+	update.gameState = GAME_STATE_UNKNOWN;
+	update.playerNumber = PLAYER_UNKNOWN;
+	return update;
+}
+
+// all ranges of a sample are decoded first and stored together, a bad range drops the whole sample.
+// Only validated samples are stored, the ATmega has already weeded out half written scores.
+void applyGameSample(const byte* payload, int length) {
+	GameUpdate update = emptyGameUpdate();
+	int offset = 3;
+
+	if (length < 3) {
+		return;
+	}
+
+	if (payload[0] != WATCH_SAMPLE_ID) {
+		if (payload[0] == sampleSentId) {
+			metricsObserve(sampleRoundTrip, micros() - sampleSentMicros);
+		}
+		sampleReplyId = payload[0];
+		sampleReplies++;
+	}
+
+	if (!(payload[1] & SAMPLE_VALIDATED)) {
+		sampleRejects++;
+		return;
+	}
+
+	for (int range = 0; range < payload[2]; range++) {
+		if (offset + 4 > length) {
+			return;
+		}
+		unsigned int address = (payload[offset] << 8) | payload[offset + 1];
+		int count = payload[offset + 2] | (payload[offset + 3] << 8);
+		offset += 4;
+
+		if (offset + count > length) {
+			return;
+		}
+		decodeGameData(address, payload + offset, count, update);
+		offset += count;
+	}
+
+	storeGameUpdate(update);
+}
+
+// fields this firmware doesn't know yet are skipped, missing ones keep their last value
+void applyAtmegaStats(const byte* payload, int length) {
+	if (length < 1) {
+		return;
+	}
+
+	for (int i = 0; i < payload[0] && i < ATMEGA_STATS_FIELDS && 1 + i * 4 + 4 <= length; i++) {
+		const byte* field = payload + 1 + i * 4;
+		atmegaStats[i] = field[0] | (field[1] << 8) | ((unsigned long)field[2] << 16) | ((unsigned long)field[3] << 24);
+	}
+	atmegaStatsTime = millis();
+}
+
+void handleGameFrame(byte type, const byte* payload, int length) {
+	lastGameFrameTime = millis();
+
+	if (type == FRAME_TYPE_SAMPLE) {
+		unsigned long start = micros();
+
+		applyGameSample(payload, length);
+		metricsObserve(sampleDecode, micros() - start);
+	} else if (type == FRAME_TYPE_STATS) {
+		applyAtmegaStats(payload, length);
+	}
+}
+
+// feed one byte from the ATmega, returns false if the byte is not part of a frame
+bool decodeGameFrame(byte c) {
+	switch (frameState) {
+		case FRAME_HUNT:
+			if (c != FRAME_SYNC) {
+				return false;
+			}
+			frameCrc = 0xFFFF;
+			frameState = FRAME_TYPE;
+			break;
+
+		case FRAME_TYPE:
+			frameType = c;
+			frameCrc = crc16Update(frameCrc, c);
+			frameState = FRAME_LENGTH_LOW;
+			break;
+
+		case FRAME_LENGTH_LOW:
+			frameLength = c;
+			frameCrc = crc16Update(frameCrc, c);
+			frameState = FRAME_LENGTH_HIGH;
 			break;
 
-		case DATA_WAIT:
-			if (millis() - timer > GAME_DATA_DELAY_MS) {  // overflow safe
-				dataState = nextDataState;
+		case FRAME_LENGTH_HIGH:
+			frameLength |= c << 8;
+			frameCrc = crc16Update(frameCrc, c);
+			frameIndex = 0;
+
+			if (frameLength > FRAME_MAX_PAYLOAD) {
+				// step over the whole frame, hunting inside its payload could find a sync byte in the data
+				frameErrors++;
+				frameSkip = frameLength + 2;
+				frameState = FRAME_SKIP;
+			} else if (frameLength == 0) {
+				frameState = FRAME_CRC_HIGH;
+			} else {
+				frameState = FRAME_PAYLOAD;
 			}
 			break;
+
+		case FRAME_PAYLOAD:
+			framePayload[frameIndex++] = c;
+			frameCrc = crc16Update(frameCrc, c);
+
+			if (frameIndex == frameLength) {
+				frameState = FRAME_CRC_HIGH;
+			}
+			break;
+
+		case FRAME_SKIP:
+			if (--frameSkip == 0) {
+				frameState = FRAME_HUNT;
+			}
+			break;
+
+		case FRAME_CRC_HIGH:
+			frameReceivedCrc = c << 8;
+			frameState = FRAME_CRC_LOW;
+			break;
+
+		case FRAME_CRC_LOW:
+			frameReceivedCrc |= c;
+			frameState = FRAME_HUNT;
+
+			if (frameReceivedCrc != frameCrc) {
+				frameErrors++;
+				Serial.printf("Game frame CRC error, count: %lu\n", frameErrors);
+				break;
+			}
+
+			handleGameFrame(frameType, framePayload, frameLength);
+			break;
 	}
+
+	return true;
 }
 
-void parseGameData(String data) {
-	int num;
-	String scoreStr;
-	int score;
-	int tmpTotalScore = 0;
+// feed one byte, returns true when line.text holds a complete line with line ends and surrounding spaces removed
+// text stays valid until the next byte is fed, bytes past LINE_MAX_LENGTH are dropped
+bool assembleLine(LineAssembler& line, byte c) {
+	if (c == '\n' || c == '\r') {
+		while (line.length > 0 && isspace(line.text[line.length - 1])) {
+			line.length--;
+		}
+		line.text[line.length] = '\0';
+
+		bool complete = line.length > 0;
+		line.length = 0;
+		return complete;
+	}
+
+	if (line.length == 0 && isspace(c)) {
+		return false;
+	}
+
+	if (line.length < LINE_MAX_LENGTH) {
+		line.text[line.length++] = c;
+	}
+	return false;
+}
+
+// feed one byte from the RFID reader, returns true when rfidFrame starts with a complete card number
+bool assembleRfid(byte c) {
+	if (c == RFID_STX) {
+		rfidLength = 0;
+		rfidInFrame = true;
+		return false;
+	}
+
+	if (!rfidInFrame) {
+		return false;
+	}
+
+	if (c == RFID_ETX) {
+		rfidInFrame = false;
+		rfidFrame[rfidLength] = '\0';
+		return rfidLength >= RFID_CARD_LENGTH;
+	}
+
+	if (rfidLength < RFID_FRAME_MAX) {
+		rfidFrame[rfidLength++] = c;
+	}
+	return false;
+}
+
+// the controller decides what a scan means, see handleCard()
+void handleRfidScan() {
+	Serial.print("RFID scan: ");
+	Serial.print(rfidFrame);
+	Serial.print(", len: ");
+	Serial.println(rfidLength);
+
+	rfidFrame[RFID_CARD_LENGTH] = '\0';  // checksum and line ends are not part of the card number
+	xQueueSend(cardQueue, rfidFrame, 0);
+}
+
+void ingestStep() {
+	while (Serial.available() > 0) {
+		if (assembleLine(usbLine, Serial.read())) {
+			gameSerial->println(usbLine.text);
+		}
+	}
+
+	while (gameSerial->available() > 0) {
+		byte c = gameSerial->read();
+
+		if (decodeGameFrame(c)) {
+			continue;
+		}
+
+		if (assembleLine(gameLine, c)) {
+			Serial.print("Game serial data: ");
+			Serial.println(gameLine.text);  // replies only, game data arrives in validated sample frames
+		}
+	}
+
+	while (Serial2.available() > 0) {
+		if (assembleRfid(Serial2.read())) {
+			handleRfidScan();
+		}
+	}
+
+	processDataState();
+}
+
+// push only the cells that differ from what is on the glass, at most once per LCD_FRAME_MS
+void lcdStep() {
+	static char frame[LCD_ROWS][LCD_COLUMNS + 1];
+	static char shown[LCD_ROWS][LCD_COLUMNS];  // zeroed, never matches text so the first frame goes out in full
+
+	if (!lcd.takeFrame(frame)) {
+		return;
+	}
+	lcdFrames++;
+
+	portENTER_CRITICAL(&metricsLock);
+	unsigned long changed = scoreChangedMicros;
+	scoreChangedMicros = 0;
+	portEXIT_CRITICAL(&metricsLock);
+	if (changed != 0) {
+		metricsObserve(scoreToLcd, micros() - changed);
+	}
+
+	for (int row = 0; row < LCD_ROWS; row++) {
+		int column = 0;
+
+		while (column < LCD_COLUMNS) {
+			if (frame[row][column] == shown[row][column]) {
+				column++;
+				continue;
+			}
 
-	if (data.startsWith("0x00A0:")) {  // game info
-		num = data.substring(56, 57).toInt();
+			int start = column;
+			int lastChanged = column;
+			for (column++; column < LCD_COLUMNS && column - lastChanged <= LCD_RUN_GAP; column++) {
+				if (frame[row][column] != shown[row][column]) {
+					lastChanged = column;
+				}
+			}
 
-		if (num >= 0 && num <= 2) {
-			gameState = num;
-			Serial.print("Set gamestate: ");
-			Serial.println(gameStateLabels[gameState]);
+			lcdDevice.setCursor(start, row);
+			for (column = start; column <= lastChanged; column++) {
+				lcdDevice.write(frame[row][column]);
+				shown[row][column] = frame[row][column];
+			}
+			lcdCursorMoves++;
+			lcdCellsWritten += lastChanged + 1 - start;
 		}
+	}
+}
+
+// "event: game" with the snapshot as JSON, player is 1 based and null with state when not known
+int formatGameEvent(const GameSnapshot& game, char* event, int size) {
+	int length = snprintf(event, size, "id: %lu\nevent: game\ndata: {\"state\":", game.sequence);
+
+	if (game.gameState == GAME_STATE_UNKNOWN) {
+		length += snprintf(event + length, size - length, "null");
+	} else {
+		length += snprintf(event + length, size - length, "\"%s\"", gameStateLabels[game.gameState]);
+	}
+	if (game.playerNumber == PLAYER_UNKNOWN) {
+		length += snprintf(event + length, size - length, ",\"player\":null");
+	} else {
+		length += snprintf(event + length, size - length, ",\"player\":%d", game.playerNumber + 1);
+	}
+	length += snprintf(event + length, size - length, ",\"total\":%d,\"scores\":[", game.totalScore);
+	for (int i = 0; i < NUM_MAX_PLAYERS; i++) {
+		length += snprintf(event + length, size - length, "%s%d", i ? "," : "", game.playerScores[i]);
+	}
+	length += snprintf(event + length, size - length, "]}\n\n");
 
-		num = data.substring(76, 77).toInt();
+	return length < size ? length : size - 1;
+}
+
+// write the whole event now or drop the client, a full socket buffer means the browser isn't keeping up
+bool eventWrite(WiFiClient& client, const char* event, int length) {
+	int fd = client.fd();
+	fd_set writable;
+	struct timeval noWait = { 0, 0 };
+
+	if (fd < 0) {
+		return false;
+	}
+	FD_ZERO(&writable);
+	FD_SET(fd, &writable);
+	if (select(fd + 1, NULL, &writable, NULL, &noWait) <= 0) {
+		return false;
+	}
+	return send(fd, event, length, MSG_DONTWAIT) == length;
+}
 
-		if (num >= 0 && num <= 3) {
-			playerNumber = num;
-			Serial.print("Set player number: ");
-			Serial.println(playerNumberLabels[playerNumber]);
+void eventBroadcast(const char* event, int length) {
+	for (int i = 0; i < EVENT_MAX_CLIENTS; i++) {
+		if (!eventClients[i]) {
+			continue;
 		}
-	} else if (gameState == GAME_STATE_IN_GAME && data.startsWith("0x0200:")) {  // player scores
-		scoreStr = data.substring(10, 12)
-			+ data.substring(15, 17)
-			+ data.substring(20, 22)
-			+ data.substring(25, 27);
-		score = scoreStr.toInt();
+		if (!eventClients[i].connected() || !eventWrite(eventClients[i], event, length)) {
+			eventClients[i].stop();
+			eventClients[i] = WiFiClient();
+			eventClientsDropped++;
+		}
+	}
+}
 
-		if (score != 0) {  // prevent button reset nuking scores before send
-			playerScores[PLAYER1] = score;
+// the response headers are written here and the socket kept in eventClients
+void handleEventsRequest() {
+	for (int i = 0; i < EVENT_MAX_CLIENTS; i++) {
+		if (eventClients[i] && eventClients[i].connected()) {
+			continue;
 		}
-		tmpTotalScore += score;
 
-		scoreStr = data.substring(30, 32)
-			+ data.substring(35, 37)
-			+ data.substring(40, 42)
-			+ data.substring(45, 47);
-		score = scoreStr.toInt();
+		char event[EVENT_MAX_LENGTH];
+		int length = formatGameEvent(readGameSnapshot(), event, sizeof(event));
+		WiFiClient client = server.client();
 
-		if (score != 0) {
-			playerScores[PLAYER2] = score;
+		client.setNoDelay(true);
+		client.print("HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n"
+			"Connection: keep-alive\r\nAccess-Control-Allow-Origin: *\r\n\r\n");
+		if (eventWrite(client, event, length)) {
+			eventClients[i] = client;
 		}
-		tmpTotalScore += score;
+		// only drops the server's reference, the socket stays open in eventClients. Left connected,
+		// WebServer would wait in HC_WAIT_CLOSE for the browser to hang up before the next request.
+		server.client().stop();
+		return;
+	}
+
+	server.send(503, "text/plain", "Too many viewers");
+}
+
+void eventStep() {
+	static unsigned long sequenceSent = 0;
+	static unsigned long lastEventTime = 0;
+	unsigned long now = millis();
+
+	if (now - lastEventTime < EVENT_MIN_INTERVAL_MS) {  // overflow safe
+		return;
+	}
+
+	GameSnapshot game = readGameSnapshot();
+	if (game.sequence != sequenceSent) {
+		char event[EVENT_MAX_LENGTH];
+		int length = formatGameEvent(game, event, sizeof(event));
+
+		eventBroadcast(event, length);
+		sequenceSent = game.sequence;
+		lastEventTime = now;
+		eventsSent++;
+	} else if (now - lastEventTime > EVENT_KEEPALIVE_MS) {  // overflow safe
+		eventBroadcast(": keepalive\n\n", 13);
+		lastEventTime = now;
+	}
+}
+
+// the /metrics body goes out in METRICS_CHUNK pieces of a chunked response
+struct MetricsWriter {
+	char text[METRICS_CHUNK];
+	int length;
+};
+
+void metricsPrintf(MetricsWriter& out, const char* format, ...) {
+	va_list args;
+
+	if (out.length > METRICS_CHUNK - 256) {  // room for the longest line
+		server.sendContent(out.text, out.length);
+		out.length = 0;
+	}
+
+	va_start(args, format);
+	int length = vsnprintf(out.text + out.length, METRICS_CHUNK - out.length, format, args);
+	va_end(args);
+
+	if (length > 0) {
+		out.length += min(length, METRICS_CHUNK - out.length - 1);
+	}
+}
+
+void metricsValue(MetricsWriter& out, const char* name, const char* type, const char* help, unsigned long value) {
+	metricsPrintf(out, "# HELP %s %s\n# TYPE %s %s\n%s %lu\n", name, help, name, type, name, value);
+}
+
+// label is empty or 'name="value",', the HELP and TYPE lines come from the caller
+void metricsHistogram(MetricsWriter& out, const char* name, const char* label, const Histogram& live) {
+	Histogram histogram;
+	unsigned long total = 0;
+
+	portENTER_CRITICAL(&metricsLock);
+	histogram = live;
+	portEXIT_CRITICAL(&metricsLock);
+
+	for (int i = 0; i < METRICS_BUCKETS; i++) {
+		total += histogram.buckets[i];
+		metricsPrintf(out, "%s_bucket{%sle=\"%g\"} %lu\n", name, label, metricsBucketsUs[i] / 1e6, total);
+	}
+	metricsPrintf(out, "%s_bucket{%sle=\"+Inf\"} %lu\n", name, label, histogram.count);
+	metricsPrintf(out, "%s_sum{%.*s} %.6f\n", name, (int)strlen(label) - 1, label, histogram.sumUs / 1e6);
+	metricsPrintf(out, "%s_count{%.*s} %lu\n", name, (int)strlen(label) - 1, label, histogram.count);
+}
 
-		scoreStr = data.substring(50, 52)
-			+ data.substring(55, 57)
-			+ data.substring(60, 62)
-			+ data.substring(65, 67);
-		score = scoreStr.toInt();
+void metricsHistogramHeader(MetricsWriter& out, const char* name, const char* help) {
+	metricsPrintf(out, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+}
 
-		if (score != 0) {
-			playerScores[PLAYER3] = score;
+void handleMetricsRequest() {
+	static MetricsWriter out;  // only the web task serves pages, keeps the buffer off its stack
+	char label[32];
+
+	out.length = 0;
+	server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+	server.send(200, "text/plain; version=0.0.4", "");
+
+	metricsHistogramHeader(out, "pinball_sample_round_trip_seconds", "mdump sent to the ATmega until its sample frame arrived");
+	metricsHistogram(out, "pinball_sample_round_trip_seconds", "", sampleRoundTrip);
+	metricsHistogramHeader(out, "pinball_sample_decode_seconds", "decoding one sample frame and storing it");
+	metricsHistogram(out, "pinball_sample_decode_seconds", "", sampleDecode);
+	metricsHistogramHeader(out, "pinball_score_to_lcd_seconds", "a changed score stored until the next LCD frame went out");
+	metricsHistogram(out, "pinball_score_to_lcd_seconds", "", scoreToLcd);
+	metricsHistogramHeader(out, "pinball_bonus_settle_seconds", "game over until the scores stopped changing and were sent");
+	metricsHistogram(out, "pinball_bonus_settle_seconds", "", bonusSettle);
+
+	metricsHistogramHeader(out, "pinball_http_request_seconds", "portal request including a reconnect, by type");
+	for (int type = 0; type < HTTP_REQUEST_TYPES; type++) {
+		snprintf(label, sizeof(label), "type=\"%s\",", httpRequestNames[type]);
+		metricsHistogram(out, "pinball_http_request_seconds", label, httpLatency[type]);
+	}
+	metricsPrintf(out, "# HELP pinball_http_failures_total portal requests without a 200, by type\n"
+		"# TYPE pinball_http_failures_total counter\n");
+	for (int type = 0; type < HTTP_REQUEST_TYPES; type++) {
+		metricsPrintf(out, "pinball_http_failures_total{type=\"%s\"} %lu\n", httpRequestNames[type], httpFailures[type]);
+	}
+	metricsValue(out, "pinball_http_reconnects_total", "counter", "requests sent again after the kept connection was closed", httpReconnects);
+	metricsValue(out, "pinball_http_queue_full_total", "counter", "controller requests not sent, the http queue was full", httpQueueFull);
+	metricsValue(out, "pinball_http_timeouts_total", "counter", "controller requests given up on without an answer", httpTimeouts);
+	metricsValue(out, "pinball_portal_connections_total", "counter", "new portal connections", portalConnects);
+	metricsValue(out, "pinball_portal_reuses_total", "counter", "requests on a kept portal connection", portalReuses);
+	metricsValue(out, "pinball_journal_pending", "gauge", "scores waiting to be posted", journalPending());
+	metricsValue(out, "pinball_journal_retries_total", "counter", "failed journal posts", journalRetries);
+	metricsValue(out, "pinball_card_cache_hits_total", "counter", "card scans answered from flash", cardCacheHits);
+	metricsValue(out, "pinball_card_cache_misses_total", "counter", "card scans that had to ask the portal", cardCacheMisses);
+
+	metricsValue(out, "pinball_frame_errors_total", "counter", "ATmega frames with a bad CRC or length", frameErrors);
+	metricsValue(out, "pinball_sample_replies_total", "counter", "mdump replies", sampleReplies);
+	metricsValue(out, "pinball_sample_timeouts_total", "counter", "mdump requests the controller gave up on", sampleTimeouts);
+	metricsValue(out, "pinball_sample_rejects_total", "counter", "samples the ATmega could not validate", sampleRejects);
+	metricsValue(out, "pinball_lcd_frames_total", "counter", "LCD frames with a change", lcdFrames);
+	metricsValue(out, "pinball_lcd_cells_written_total", "counter", "LCD characters sent", lcdCellsWritten);
+	metricsValue(out, "pinball_events_sent_total", "counter", "game events streamed on /events", eventsSent);
+	metricsValue(out, "pinball_event_viewers_dropped_total", "counter", "/events viewers closed or too slow", eventClientsDropped);
+
+	if (atmegaStatsTime != 0) {
+		for (int i = 0; i < ATMEGA_STATS_FIELDS; i++) {
+			metricsValue(out, atmegaStatsNames[i], i == 0 ? "gauge" : "counter", "from the ATmega stats frame", atmegaStats[i]);
 		}
-		tmpTotalScore += score;
+		metricsValue(out, "pinball_atmega_stats_age_ms", "gauge", "time since the ATmega stats frame", millis() - atmegaStatsTime);
+	}
 
-		scoreStr = data.substring(70, 72)
-			+ data.substring(75, 77)
-			+ data.substring(80, 82)
-			+ data.substring(85, 87);
-		score = scoreStr.toInt();
+	server.sendContent(out.text, out.length);
+}
 
-		if (score != 0) {
-			playerScores[PLAYER4] = score;
+void webStep() {
+	server.handleClient();
+	eventStep();
+}
+
+PipelineTask pipelineTasks[] = {
+	{ "ingest", ingestStep, 4096, 3, 1, 1 },
+	{ "controller", processControllerState, 6144, 2, 1, 5 },
+	{ "http", httpStep, 8192, 1, 0, 0 },
+	{ "lcd", lcdStep, 3072, 1, 1, pdMS_TO_TICKS(LCD_FRAME_MS) },
+	{ "web", webStep, 6144, 1, 0, 2 },
+};
+#define NUM_PIPELINE_TASKS (int)(sizeof(pipelineTasks) / sizeof(pipelineTasks[0]))
+
+// time from the start of one step to the start of the next, how long the task couldn't react
+void markTaskStep(PipelineTask* task) {
+	unsigned long now = micros();
+
+	portENTER_CRITICAL(&taskStatsLock);
+	if (task->lastStart != 0) {
+		unsigned long gap = now - task->lastStart;
+		task->totalGap += gap;
+		if (gap > task->maxGap) {
+			task->maxGap = gap;
 		}
-		tmpTotalScore += score;
+	}
+	task->steps++;
+	task->lastStart = now;
+	portEXIT_CRITICAL(&taskStatsLock);
+}
 
-		totalScore = tmpTotalScore;
+void runPipelineTask(void* parameter) {
+	PipelineTask* task = (PipelineTask*)parameter;
 
-		Serial.println("Set player scores.");
+	for (;;) {
+		markTaskStep(task);
+		task->step();
+		if (task->delayTicks > 0) {
+			vTaskDelay(task->delayTicks);
+		}
 	}
 }
 
+void reportTaskLatency() {
+	for (int i = 0; i < NUM_PIPELINE_TASKS; i++) {
+		PipelineTask* task = &pipelineTasks[i];
+		unsigned long steps;
+		unsigned long maxGap;
+		unsigned long totalGap;
+
+		portENTER_CRITICAL(&taskStatsLock);
+		steps = task->steps;
+		maxGap = task->maxGap;
+		totalGap = task->totalGap;
+		task->steps = 0;
+		task->maxGap = 0;
+		task->totalGap = 0;
+		portEXIT_CRITICAL(&taskStatsLock);
+
+		Serial.printf("[TASK] %-10s steps: %6lu avg: %8.2f ms max: %8.2f ms\n", task->name, steps,
+			steps > 0 ? totalGap / 1000.0 / steps : 0.0, maxGap / 1000.0);
+	}
+
+	Serial.printf("[HTTP] Portal connections opened: %lu, requests on a kept connection: %lu\n", portalConnects, portalReuses);
+	Serial.printf("[JOURNAL] Scores waiting to be sent: %lu\n", journalPending());
+	Serial.printf("[CARD] Cache hits: %lu, misses: %lu\n", cardCacheHits, cardCacheMisses);
+	Serial.printf("[GAME] Sample replies: %lu, timed out: %lu, not validated: %lu\n", sampleReplies, sampleTimeouts, sampleRejects);
+	Serial.printf("[LCD] Frames: %lu, cursor moves: %lu, cells written: %lu\n", lcdFrames, lcdCursorMoves, lcdCellsWritten);
+	Serial.printf("[WEB] Events sent: %lu, viewers dropped: %lu\n", eventsSent, eventClientsDropped);
+}
+
 void setup() {
 	Serial.begin(115200);
-	Serial.setTimeout(50);
 
 	if (*gameSerial == Serial1) {
 		Serial.println("Game serial configured as Serial1 (ATmega).");
+		gameSerial->setRxBufferSize(GAME_SERIAL_RX_BUFFER);  // must come before begin()
 		gameSerial->begin(115200, SERIAL_8N1, RX1_PIN, TX1_PIN);
-		gameSerial->setTimeout(50);
 	}
 
 	Serial2.begin(9600, SERIAL_8N1, RX2_PIN, TX2_PIN);
-	Serial2.setTimeout(50);
 
 	Serial.println("Host boot up");
 	Serial.println("Waiting 2 seconds...");
 
 	delay(2000);
 
-	lcd.init();
-	lcd.backlight();
+	lcdDevice.init();
+	lcdDevice.backlight();
 
 	lcd.clear();
 	lcd.print("BOOT UP");
@@ -706,67 +2428,50 @@ void setup() {
 	//X509List cert(lets_encrypt_ca);
 	//wc.setTrustAnchors(&cert);
 	wc.setInsecure();  // disables all SSL checks. don't use in production
+	portalHttp.setReuse(true);
 
 	server.on("/", []() {
 			server.send(200, "text/html", "<i>SEE YOU PINBALL WIZARD...</i>");
 			});
+	server.on("/events", handleEventsRequest);
+	server.on("/metrics", handleMetricsRequest);
+	server.on("/live", []() {
+			server.send(200, "text/html", LIVE_PAGE);
+			});
 
 	ElegantOTA.begin(&server);
 	//WebSerial.begin(&server);
 	//WebSerial.msgCallback(recvMsg);
 	server.begin();
 
-	Serial.println("Setup complete.");
-	delay(500);
-}
-
-void loop() {
-	if (Serial.available() > 0) {
-		String data = Serial.readString();
-		data.trim();
-
-		gameSerial->println(data);
+	flashMounted = LittleFS.begin(true);
+	if (!flashMounted) {
+		Serial.println("LittleFS mount failed, scores and cards will not survive a reset.");
 	}
+	journalBegin();
+	cardCacheBegin();
 
-	if (gameSerial->available() > 0) {
-		String data = gameSerial->readString();
-		data.trim();
-		Serial.print("Game serial data: ");
-		Serial.println(data);
+	httpRequests = xQueueCreate(HTTP_QUEUE_LENGTH, sizeof(HttpRequest));
+	httpResponses = xQueueCreate(HTTP_QUEUE_LENGTH, sizeof(HttpResponse));
+	cardQueue = xQueueCreate(CARD_QUEUE_LENGTH, RFID_CARD_LENGTH + 1);
 
-		if (data.length() > 8) {
-			parseGameData(data);
-		}
+	for (int i = 0; i < NUM_PIPELINE_TASKS; i++) {
+		PipelineTask* task = &pipelineTasks[i];
+		xTaskCreatePinnedToCore(runPipelineTask, task->name, task->stackSize, task, task->priority, NULL, task->core);
 	}
 
-	if (Serial2.available() > 0) {
-		String data = Serial2.readString();
-
-		Serial.print("RFID scan: ");
-		Serial.print(data);
-		Serial.print(", len: ");
-		Serial.println(data.length());
-
-		if (data.substring(1, 11) == "0700B5612A") {
-			rebootArduino();
-		}
-
-		if (controllerState == CONTROLLER_IN_GAME && playerNumber >= 0) {
-			bool nameIsSet = playerNames[playerNumber].length() > 0;
-			bool hasSomeScore = playerScores[playerNumber] > 10000;
-
-			if (!nameIsSet && !hasSomeScore) {
-				scannedCard = data.substring(1, 11);
+	Serial.println("Setup complete.");
+	delay(500);
+}
 
-				Serial.print("Card: ");
-				Serial.println(scannedCard);
+// everything else runs in the pipeline tasks started by setup()
+void loop() {
+	static unsigned long timer = millis();
 
-				controllerState = CONTROLLER_GET_NAME;
-			}
-		}
+	if (millis() - timer > TASK_REPORT_INTERVAL_MS) {  // overflow safe
+		timer = millis();
+		reportTaskLatency();
 	}
 
-	processControllerState();
-	processDataState();
-	server.handleClient();
+	delay(1000);
 }
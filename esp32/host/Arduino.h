@@ -0,0 +1,210 @@
+// Arduino.h
+// Host stand-in for the parts of the ESP32 Arduino core and FreeRTOS that esp32.ino uses.
+//
+// Time is virtual. hostNow is the start of the step the harness is running and hostStepUs is what that
+// step has used so far, delay(), portal requests and LCD writes add to it instead of sleeping, so
+// millis() and micros() inside a step move just like on the ESP32 while a replay runs much faster.
+// There is one thread. Critical sections and mutexes do nothing and queues never block, the harness in
+// main.cpp runs each pipeline task's step in turn instead of starting FreeRTOS tasks.
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define HOST_BUILD
+
+typedef uint8_t byte;
+
+using std::min;
+using std::max;
+
+#define PROGMEM
+
+// ***** clock *****
+
+extern uint64_t hostNow;      // us, start of the step being run
+extern uint64_t hostStepUs;   // us the running step has spent, see above
+
+inline uint64_t hostMicros() {
+	return hostNow + hostStepUs;
+}
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+// time() reads the virtual clock, near zero until configTime() as on the ESP32 before NTP answers
+#define HOST_EPOCH 1792195200  // 2026-10-17 00:00 UTC
+time_t hostTime(time_t* now);
+void configTime(long gmtOffset, int daylightOffset, const char* server1, const char* server2);
+#define time(now) hostTime(now)
+
+size_t strlcpy(char* destination, const char* source, size_t size);
+
+// ***** String *****
+
+class String {
+	public:
+		String() {}
+		String(const char* text) : text(text ? text : "") {}
+		String(const std::string& text) : text(text) {}
+		String(int value) : text(std::to_string(value)) {}
+		String(unsigned int value) : text(std::to_string(value)) {}
+		String(long value) : text(std::to_string(value)) {}
+		String(unsigned long value) : text(std::to_string(value)) {}
+
+		unsigned int length() const { return text.size(); }
+		const char* c_str() const { return text.c_str(); }
+		bool startsWith(const String& prefix) const { return text.compare(0, prefix.text.size(), prefix.text) == 0; }
+
+		String operator+(const String& other) const { return String(text + other.text); }
+		friend String operator+(const char* left, const String& right) { return String(std::string(left) + right.text); }
+		String& operator+=(const String& other) { text += other.text; return *this; }
+		bool operator==(const String& other) const { return text == other.text; }
+		bool operator!=(const String& other) const { return text != other.text; }
+
+	private:
+		std::string text;
+};
+
+class IPAddress {
+	public:
+		IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : octets{ a, b, c, d } {}
+		String toString() const;
+
+	private:
+		uint8_t octets[4];
+};
+
+// ***** Print *****
+
+class Print {
+	public:
+		virtual ~Print() {}
+		virtual size_t write(uint8_t c) = 0;
+		virtual size_t write(const uint8_t* buffer, size_t size);
+		size_t write(const char* text) { return write((const uint8_t*)text, strlen(text)); }
+
+		size_t print(const char* text) { return write(text); }
+		size_t print(const String& text) { return write(text.c_str()); }
+		size_t print(const IPAddress& address) { return print(address.toString()); }
+		size_t print(char c) { return write((uint8_t)c); }
+		size_t print(int value) { return printf("%d", value); }
+		size_t print(unsigned int value) { return printf("%u", value); }
+		size_t print(long value) { return printf("%ld", value); }
+		size_t print(unsigned long value) { return printf("%lu", value); }
+		size_t print(double value) { return printf("%.2f", value); }
+
+		size_t println() { return write("\r\n"); }
+		template <typename T> size_t println(const T& value) { return print(value) + println(); }
+
+		size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+// ***** HardwareSerial *****
+
+#define SERIAL_8N1 0x800001c
+
+// Sketch output is kept in output for the harness, or echoed to stdout with the virtual time in front.
+// The harness queues input with inject(), bytes become readable one character time apart.
+class HardwareSerial : public Print {
+	public:
+		HardwareSerial(const char* name) : name(name) {}
+
+		void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1);
+		size_t setRxBufferSize(size_t size) { return size; }
+		int available();
+		int read();
+		size_t write(uint8_t c) override;
+		using Print::write;
+		bool operator==(const HardwareSerial& other) const { return this == &other; }
+
+		void inject(uint64_t at, const uint8_t* data, size_t length);
+		unsigned long byteUs() const { return 10000000UL / baud; }
+
+		const char* name;
+		unsigned long baud = 115200;
+		bool echo = false;
+		bool capture = false;
+		std::string output;
+
+	private:
+		std::deque<std::pair<uint64_t, uint8_t> > input;
+		uint64_t lastArrival = 0;
+		bool lineStart = true;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+
+class EspClass {
+	public:
+		void restart();
+};
+extern EspClass ESP;
+
+// ***** FreeRTOS *****
+
+typedef uint32_t TickType_t;
+typedef unsigned int UBaseType_t;
+typedef int BaseType_t;
+typedef void* TaskHandle_t;
+typedef void* SemaphoreHandle_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define errQUEUE_FULL 0
+#define portMAX_DELAY 0xFFFFFFFF
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms) / portTICK_PERIOD_MS)
+
+struct portMUX_TYPE {
+	uint32_t owner;
+	uint32_t count;
+};
+#define portMUX_INITIALIZER_UNLOCKED { 0, 0 }
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+
+// an item can be received once the receiving task's clock has passed the time it was sent
+struct HostQueue {
+	UBaseType_t length;
+	UBaseType_t itemSize;
+	std::deque<std::pair<uint64_t, std::vector<uint8_t> > > items;
+};
+typedef HostQueue* QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t wait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t wait);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue);
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return NULL; }
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t wait) { return pdTRUE; }
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) { return pdTRUE; }
+
+// the harness runs pipelineTasks itself, nothing is started here
+BaseType_t xTaskCreatePinnedToCore(void (*task)(void*), const char* name, uint32_t stackSize, void* parameter,
+	UBaseType_t priority, TaskHandle_t* handle, BaseType_t core);
+void vTaskDelay(TickType_t ticks);
+
+#endif
@@ -0,0 +1,48 @@
+// ArduinoJson.h
+// host stand-in, just enough for the flat string fields the portal sends
+#ifndef ArduinoJson_h
+#define ArduinoJson_h
+
+#include "Arduino.h"
+
+struct JsonHostValue {
+	std::string text;
+	bool found;
+
+	const char* operator|(const char* otherwise) const { return found ? text.c_str() : otherwise; }
+};
+
+template <size_t capacity>
+class StaticJsonDocument {
+	public:
+		// the string value of "key", not found when it is missing or not a string
+		JsonHostValue operator[](const char* key) const {
+			JsonHostValue value = { "", false };
+			std::string quoted = std::string("\"") + key + "\"";
+			size_t at = text.find(quoted);
+
+			if (at == std::string::npos) {
+				return value;
+			}
+			at = text.find_first_not_of(" \t\r\n:", at + quoted.size());
+			if (at == std::string::npos || text[at] != '"') {
+				return value;
+			}
+			size_t end = text.find('"', at + 1);
+			if (end != std::string::npos) {
+				value.text = text.substr(at + 1, end - at - 1);
+				value.found = true;
+			}
+			return value;
+		}
+
+		std::string text;
+};
+
+template <size_t capacity>
+int deserializeJson(StaticJsonDocument<capacity>& document, const String& json) {
+	document.text = json.c_str();
+	return 0;
+}
+
+#endif
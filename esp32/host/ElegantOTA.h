@@ -0,0 +1,14 @@
+// ElegantOTA.h
+// host stand-in, nothing to update
+#ifndef ElegantOTA_h
+#define ElegantOTA_h
+
+#include "WebServer.h"
+
+class ElegantOTAClass {
+	public:
+		void begin(WebServer* server) {}
+};
+extern ElegantOTAClass ElegantOTA;
+
+#endif
@@ -0,0 +1,299 @@
+// EspHost.cpp
+// Host side of the stand-ins in this directory: virtual clock, serial ports, queues, the in memory
+// LittleFS and the portal stand-in.
+
+#include "Arduino.h"
+#include "WiFi.h"
+#include "HTTPClient.h"
+#include "LittleFS.h"
+#include "ElegantOTA.h"
+
+#define PORTAL_IDLE_CLOSE_US 60000000ULL  // the portal drops a kept connection idle this long
+
+uint64_t hostNow = 0;
+uint64_t hostStepUs = 0;
+static bool clockSet = false;
+
+HardwareSerial Serial("usb");
+HardwareSerial Serial1("atmega");
+HardwareSerial Serial2("rfid");
+EspClass ESP;
+WiFiClass WiFi;
+ElegantOTAClass ElegantOTA;
+LittleFSFS LittleFS;
+
+std::vector<PortalRequest> hostPortalLog;
+int hostPortalResult = HTTP_CODE_OK;
+unsigned long hostPortalUs = 150000;
+unsigned long hostConnectUs = 600000;
+
+// ***** clock *****
+
+unsigned long millis() {
+	return hostMicros() / 1000;
+}
+
+unsigned long micros() {
+	return hostMicros();
+}
+
+void delay(unsigned long ms) {
+	hostStepUs += ms * 1000;
+}
+
+void yield() {
+}
+
+void vTaskDelay(TickType_t ticks) {
+	hostStepUs += (uint64_t)ticks * portTICK_PERIOD_MS * 1000;
+}
+
+time_t hostTime(time_t* now) {
+	time_t seconds = hostMicros() / 1000000;
+
+	if (clockSet) {
+		seconds += HOST_EPOCH;
+	}
+	if (now != NULL) {
+		*now = seconds;
+	}
+	return seconds;
+}
+
+void configTime(long gmtOffset, int daylightOffset, const char* server1, const char* server2) {
+	clockSet = true;
+}
+
+size_t strlcpy(char* destination, const char* source, size_t size) {
+	size_t length = strlen(source);
+
+	if (size > 0) {
+		size_t copied = length < size - 1 ? length : size - 1;
+		memcpy(destination, source, copied);
+		destination[copied] = '\0';
+	}
+	return length;
+}
+
+void EspClass::restart() {
+	fflush(NULL);
+	printf("> ESP.restart() at %.3f s, replay stopped\n", hostMicros() / 1e6);
+	exit(2);
+}
+
+String IPAddress::toString() const {
+	char text[16];
+
+	snprintf(text, sizeof(text), "%u.%u.%u.%u", octets[0], octets[1], octets[2], octets[3]);
+	return String(text);
+}
+
+// ***** Print *****
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+	for (size_t i = 0; i < size; i++) {
+		write(buffer[i]);
+	}
+	return size;
+}
+
+size_t Print::printf(const char* format, ...) {
+	char text[512];
+	va_list args;
+
+	va_start(args, format);
+	int length = vsnprintf(text, sizeof(text), format, args);
+	va_end(args);
+
+	if (length < 0) {
+		return 0;
+	}
+	return write((const uint8_t*)text, min((size_t)length, sizeof(text) - 1));
+}
+
+// ***** HardwareSerial *****
+
+void HardwareSerial::begin(unsigned long newBaud, uint32_t config, int8_t rxPin, int8_t txPin) {
+	baud = newBaud;
+}
+
+int HardwareSerial::available() {
+	int count = 0;
+
+	for (size_t i = 0; i < input.size() && input[i].first <= hostMicros(); i++) {
+		count++;
+	}
+	return count;
+}
+
+int HardwareSerial::read() {
+	if (input.empty() || input.front().first > hostMicros()) {
+		return -1;
+	}
+	int c = input.front().second;
+	input.pop_front();
+	return c;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+	if (capture) {
+		output += (char)c;
+	}
+	if (echo) {
+		if (lineStart) {
+			::printf("%10.3f %-6s ", hostMicros() / 1e6, name);  // not Print::printf
+		}
+		if (c != '\r') {
+			::putchar(c);
+		}
+		lineStart = c == '\n';
+	}
+	return 1;
+}
+
+// the line is busy until the bytes already queued are through, each byte takes one character time
+void HardwareSerial::inject(uint64_t at, const uint8_t* data, size_t length) {
+	uint64_t arrival = max(at, lastArrival);
+
+	for (size_t i = 0; i < length; i++) {
+		arrival += byteUs();
+		input.push_back(std::make_pair(arrival, data[i]));
+	}
+	lastArrival = arrival;
+}
+
+// ***** queues *****
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+	HostQueue* queue = new HostQueue;
+
+	queue->length = length;
+	queue->itemSize = itemSize;
+	return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t wait) {
+	if (queue->items.size() >= queue->length) {
+		return errQUEUE_FULL;
+	}
+	queue->items.push_back(std::make_pair(hostMicros(),
+		std::vector<uint8_t>((const uint8_t*)item, (const uint8_t*)item + queue->itemSize)));
+	return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t wait) {
+	if (queue->items.empty() || queue->items.front().first > hostMicros()) {
+		return pdFALSE;
+	}
+	memcpy(item, queue->items.front().second.data(), queue->itemSize);
+	queue->items.pop_front();
+	return pdTRUE;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+	return queue->length - queue->items.size();
+}
+
+BaseType_t xTaskCreatePinnedToCore(void (*task)(void*), const char* name, uint32_t stackSize, void* parameter,
+	UBaseType_t priority, TaskHandle_t* handle, BaseType_t core) {
+	return pdPASS;
+}
+
+// ***** LittleFS *****
+
+size_t File::read(uint8_t* buffer, size_t size) {
+	if (!data || offset >= data->size()) {
+		return 0;
+	}
+	size = min(size, data->size() - offset);
+	memcpy(buffer, data->data() + offset, size);
+	offset += size;
+	return size;
+}
+
+size_t File::write(const uint8_t* buffer, size_t size) {
+	if (!data || !writable) {
+		return 0;
+	}
+	if (offset + size > data->size()) {
+		data->resize(offset + size);
+	}
+	memcpy(data->data() + offset, buffer, size);
+	offset += size;
+	return size;
+}
+
+bool File::seek(size_t position) {
+	if (!data || position > data->size()) {
+		return false;
+	}
+	offset = position;
+	return true;
+}
+
+File LittleFSFS::open(const char* path, const char* mode) {
+	std::shared_ptr<std::vector<uint8_t> >& data = files[path];
+
+	if (mode[0] == 'r') {
+		if (!data) {
+			files.erase(path);
+			return File();
+		}
+		return File(data, false, 0);
+	}
+	if (!data || mode[0] == 'w') {
+		data = std::make_shared<std::vector<uint8_t> >();
+	}
+	return File(data, true, mode[0] == 'a' ? data->size() : 0);
+}
+
+bool LittleFSFS::rename(const char* from, const char* to) {
+	if (files.count(from) == 0) {
+		return false;
+	}
+	files[to] = files[from];
+	files.erase(from);
+	return true;
+}
+
+// ***** portal stand-in *****
+
+// answers like the portal, every request is logged in hostPortalLog for the harness
+int HTTPClient::request(const char* method, const std::string& payload) {
+	std::string path = url.c_str();
+	size_t hostEnd = path.find('/', path.find("//") + 2);
+	PortalRequest logged;
+	char card[16];
+
+	path = hostEnd == std::string::npos ? "/" : path.substr(hostEnd);
+	response.clear();
+
+	if (client->open && hostMicros() - client->lastUsed > PORTAL_IDLE_CLOSE_US) {
+		client->open = false;  // found out when the request goes nowhere
+		logged.result = HTTPC_ERROR_SEND_HEADER_FAILED;
+	} else if (hostPortalResult == 0) {
+		hostStepUs += hostConnectUs;
+		client->open = false;
+		logged.result = HTTPC_ERROR_CONNECTION_REFUSED;
+	} else {
+		if (!client->open) {
+			hostStepUs += hostConnectUs;
+			client->open = true;
+		}
+		hostStepUs += hostPortalUs;
+		client->lastUsed = hostMicros();
+		logged.result = hostPortalResult;
+
+		if (sscanf(path.c_str(), "/pinball/%15[^/]/get_name/", card) == 1 && hostPortalResult == HTTP_CODE_OK) {
+			response = std::string("{\"name\":\"Player ") + (strlen(card) > 4 ? card + strlen(card) - 4 : card)
+				+ "\",\"drink\":\"Water\"}";
+		}
+	}
+
+	logged.at = hostMicros();
+	logged.method = method;
+	logged.path = path;
+	logged.body = payload;
+	hostPortalLog.push_back(logged);
+	return logged.result;
+}
@@ -0,0 +1,55 @@
+// HTTPClient.h
+// host stand-in, requests go to the portal stand-in in EspHost.cpp and cost the http task
+// hostPortalUs each, plus hostConnectUs when the client has no open connection to reuse.
+#ifndef HTTPClient_h
+#define HTTPClient_h
+
+#include "WiFi.h"
+
+#define HTTP_CODE_OK 200
+#define HTTP_CODE_NOT_FOUND 404
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+
+// one request as the portal saw it, at is when the answer went back
+struct PortalRequest {
+	uint64_t at;
+	std::string method;
+	std::string path;
+	std::string body;
+	int result;
+};
+
+extern std::vector<PortalRequest> hostPortalLog;
+extern int hostPortalResult;          // HTTP code the portal answers with, 0 when it can't be reached
+extern unsigned long hostPortalUs;
+extern unsigned long hostConnectUs;
+
+class HTTPClient {
+	public:
+		bool begin(WiFiClient& newClient, const String& newUrl) {
+			client = &newClient;
+			url = newUrl;
+			return true;
+		}
+		void setReuse(bool reuse) {}
+		void addHeader(const String& name, const String& value) {}
+		int GET() { return request("GET", ""); }
+		int POST(const String& payload) { return request("POST", payload.c_str()); }
+		int POST(uint8_t* payload, size_t size) { return request("POST", std::string((const char*)payload, size)); }
+		String getString() { return String(response); }
+		String errorToString(int error) { return String(error < 0 ? "connection refused" : ""); }
+		void end() {}
+
+	private:
+		int request(const char* method, const std::string& payload);
+
+		WiFiClient* client = NULL;
+		String url;
+		std::string response;
+};
+
+#endif
@@ -0,0 +1,3 @@
+// HardwareSerial.h
+// host stand-in, HardwareSerial is in Arduino.h
+#include "Arduino.h"
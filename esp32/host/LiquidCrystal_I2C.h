@@ -0,0 +1,48 @@
+// LiquidCrystal_I2C.h
+// host stand-in, characters land in glass. Each character or cursor move costs the lcd task
+// LCD_HOST_BYTE_US, about two nibbles of three PCF8574 writes each at 100 kHz.
+#ifndef LiquidCrystal_I2C_h
+#define LiquidCrystal_I2C_h
+
+#include "Arduino.h"
+
+#define LCD_HOST_BYTE_US 540
+
+class LiquidCrystal_I2C : public Print {
+	public:
+		LiquidCrystal_I2C(uint8_t address, uint8_t columns, uint8_t rows) : columns(columns), rows(rows) {
+			clear();
+		}
+
+		void init() {}
+		void backlight() {}
+		void clear() {
+			memset(glass, ' ', sizeof(glass));
+			column = 0;
+			row = 0;
+		}
+		void setCursor(uint8_t newColumn, uint8_t newRow) {
+			column = newColumn;
+			row = newRow < rows ? newRow : rows - 1;
+			hostStepUs += LCD_HOST_BYTE_US;
+		}
+		size_t write(uint8_t c) override {
+			if (column < columns) {
+				glass[row][column] = c;
+			}
+			column++;
+			hostStepUs += LCD_HOST_BYTE_US;
+			return 1;
+		}
+		using Print::write;
+
+		char glass[4][20];
+
+	private:
+		uint8_t columns;
+		uint8_t rows;
+		uint8_t column = 0;
+		uint8_t row = 0;
+};
+
+#endif
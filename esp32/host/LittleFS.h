@@ -0,0 +1,45 @@
+// LittleFS.h
+// host stand-in, files live in memory for the run so the journal and card cache work as on flash
+#ifndef LittleFS_h
+#define LittleFS_h
+
+#include "Arduino.h"
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+class File {
+	public:
+		File() {}
+		File(std::shared_ptr<std::vector<uint8_t> > data, bool writable, size_t position)
+			: data(data), writable(writable), offset(position) {}
+
+		explicit operator bool() const { return data != NULL; }
+		size_t read(uint8_t* buffer, size_t size);
+		size_t write(const uint8_t* buffer, size_t size);
+		bool seek(size_t position);
+		size_t position() const { return offset; }
+		int available() const { return data ? data->size() - offset : 0; }
+		void close() { data.reset(); }
+
+	private:
+		std::shared_ptr<std::vector<uint8_t> > data;
+		bool writable = false;
+		size_t offset = 0;
+};
+
+class LittleFSFS {
+	public:
+		bool begin(bool formatOnFail = false) { return true; }
+		File open(const char* path, const char* mode);
+		bool remove(const char* path) { return files.erase(path) > 0; }
+		bool rename(const char* from, const char* to);
+		bool exists(const char* path) { return files.count(path) > 0; }
+
+	private:
+		std::map<std::string, std::shared_ptr<std::vector<uint8_t> > > files;
+};
+extern LittleFSFS LittleFS;
+
+#endif
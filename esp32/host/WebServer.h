@@ -0,0 +1,40 @@
+// WebServer.h
+// host stand-in, nothing listens. The harness calls a handler with request() and gets back what it sent.
+#ifndef WebServer_h
+#define WebServer_h
+
+#include "WiFi.h"
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+
+class WebServer {
+	public:
+		WebServer(int port) {}
+
+		void on(const char* path, std::function<void()> handler) { handlers[path] = handler; }
+		void begin() {}
+		void handleClient() {}
+		WiFiClient client() { return WiFiClient(); }
+
+		void setContentLength(size_t length) {}
+		void send(int code, const char* type, const char* content) { body += content; }
+		void send(int code, const char* type, const String& content) { body += content.c_str(); }
+		void sendContent(const char* content, size_t length) { body.append(content, length); }
+		void sendContent(const String& content) { body += content.c_str(); }
+
+		bool request(const char* path, std::string& response) {
+			if (handlers.count(path) == 0) {
+				return false;
+			}
+			body.clear();
+			handlers[path]();
+			response = body;
+			return true;
+		}
+
+	private:
+		std::map<std::string, std::function<void()> > handlers;
+		std::string body;
+};
+
+#endif
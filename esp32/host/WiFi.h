@@ -0,0 +1,39 @@
+// WiFi.h
+// host stand-in, WiFi is always connected. A client is open from its first portal request until stop(),
+// see HTTPClient.h, and has no socket so eventWrite() drops it.
+#ifndef WiFi_h
+#define WiFi_h
+
+#include "Arduino.h"
+
+#define WIFI_OFF 0
+#define WIFI_STA 1
+
+#define WL_CONNECTED 3
+#define WL_DISCONNECTED 6
+
+class WiFiClient : public Print {
+	public:
+		size_t write(uint8_t c) override { return open ? 1 : 0; }
+		using Print::write;
+		bool connected() const { return open; }
+		void stop() { open = false; }
+		int fd() const { return -1; }
+		void setNoDelay(bool noDelay) {}
+		explicit operator bool() const { return open; }
+
+		bool open = false;
+		uint64_t lastUsed = 0;  // hostMicros() of the last answer on this connection
+};
+
+class WiFiClass {
+	public:
+		void mode(int mode) {}
+		void begin(const char* ssid, const char* password) {}
+		void disconnect() {}
+		int status() { return WL_CONNECTED; }
+		IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+};
+extern WiFiClass WiFi;
+
+#endif
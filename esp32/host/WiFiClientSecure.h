@@ -0,0 +1,13 @@
+// WiFiClientSecure.h
+// host stand-in, the TLS handshake is the connect time in HTTPClient.h
+#ifndef WiFiClientSecure_h
+#define WiFiClientSecure_h
+
+#include "WiFi.h"
+
+class WiFiClientSecure : public WiFiClient {
+	public:
+		void setInsecure() {}
+};
+
+#endif
@@ -0,0 +1,3 @@
+// Wire.h
+// host stand-in, LiquidCrystal_I2C.h does without a bus
+#include "Arduino.h"
@@ -0,0 +1,4 @@
+// lwip/sockets.h
+// host stand-in, select() and send() come from the host C library
+#include <sys/select.h>
+#include <sys/socket.h>
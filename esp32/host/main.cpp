@@ -0,0 +1,604 @@
+// main.cpp
+// Linux replay harness for esp32.ino. Boots the firmware against the stand-ins in this directory, plays a
+// trace of game RAM writes and card scans into it through a model of the ATmega, and reports how long a
+// score change takes to reach sharedGame and the portal.
+//
+//   ./esp32_replay [options] trace
+//
+// see README.md for the trace format and the options
+
+#include "Arduino.h"
+#include "../esp32.ino"
+
+#define ATMEGA_RAM_SIZE 2048
+#define ATMEGA_REPLY_US 500        // end of a command line to the first byte of the answer
+#define ATMEGA_WATCH_US 10000      // WATCH_INTERVAL_MS in atmel.ino, until watchinterval changes it
+#define DEFAULT_TAIL_MS 15000      // keep going after the last trace line so the scores get posted
+#define READY_TIMEOUT_US 60000000ULL
+
+enum traceKinds {
+	TRACE_WRITE,
+	TRACE_SCAN,
+	TRACE_PORTAL,
+};
+
+struct TraceLine {
+	uint64_t at;  // us after the controller first reached CONTROLLER_IDLE
+	enum traceKinds kind;
+	unsigned int address;
+	std::vector<uint8_t> data;
+	std::string card;
+	int result;
+};
+
+struct AtmegaRange {
+	unsigned int start;
+	unsigned int count;
+};
+
+// the newest write of a player's score, and whether sharedGame has shown it yet
+struct ScoreChange {
+	int value;
+	uint64_t at;
+	bool waiting;
+};
+
+static std::vector<TraceLine> traceLines;
+static bool verbose = false;
+static bool showMetrics = false;
+static unsigned long tailMs = DEFAULT_TAIL_MS;
+
+// the ATmega as esp32.ino sees it: game RAM, validate, watch and mdump
+static uint8_t gameRam[ATMEGA_RAM_SIZE];
+static bool atmegaValidate = false;
+static AtmegaRange atmegaValidateRange = { 0, 0 };
+static std::vector<AtmegaRange> atmegaWatch;
+static std::vector<uint8_t> atmegaWatchSent;
+static bool atmegaWatchAll = false;
+static uint64_t atmegaWatchNext = 0;
+static uint64_t atmegaWatchUs = ATMEGA_WATCH_US;
+static unsigned long atmegaWatchPolls = 0;
+static std::string atmegaLine;
+static unsigned long atmegaFrames = 0;
+
+static ScoreChange pendingScores[NUM_MAX_PLAYERS];
+static ScoreChange latestScores[NUM_MAX_PLAYERS];
+static uint64_t gameOverAt = 0;
+static bool gameOverWaiting = false;
+static std::vector<double> detectMs;
+static std::vector<double> submitMs;
+static std::vector<double> gameOverMs;
+static unsigned long scoreChanges = 0;
+static unsigned long scoresCoalesced = 0;
+static unsigned long scorePosts = 0;
+static unsigned long wrongScores = 0;
+static size_t portalSeen = 0;
+
+// ***** trace *****
+
+// "<ms> 0x0200: 0x00 0x12 ..." writes game RAM, "<ms> scan <card>" is an RFID scan,
+// "<ms> portal <code>" sets what the portal answers from then on
+static bool loadTrace(const char* fileName) {
+	FILE* file = fopen(fileName, "r");
+	char text[1024];
+	int lineNumber = 0;
+
+	if (file == NULL) {
+		fprintf(stderr, "can't open %s\n", fileName);
+		return false;
+	}
+
+	while (fgets(text, sizeof(text), file)) {
+		TraceLine line;
+		char* end;
+		char word[32];
+
+		lineNumber++;
+		char* rest = text + strspn(text, " \t");
+		if (*rest == '#' || *rest == '\n' || *rest == '\r' || *rest == '\0') {
+			continue;
+		}
+
+		double ms = strtod(rest, &end);
+		if (end == rest || ms < 0) {
+			fprintf(stderr, "%s:%d: no time\n", fileName, lineNumber);
+			fclose(file);
+			return false;
+		}
+		line.at = (uint64_t)(ms * 1000);
+		rest = end;
+
+		if (sscanf(rest, " scan %31s", word) == 1) {
+			line.kind = TRACE_SCAN;
+			line.card = word;
+		} else if (sscanf(rest, " portal %d", &line.result) == 1) {
+			line.kind = TRACE_PORTAL;
+		} else {
+			line.kind = TRACE_WRITE;
+			line.address = strtoul(rest, &end, 16);
+			if (end == rest || *end != ':' || line.address >= ATMEGA_RAM_SIZE) {
+				fprintf(stderr, "%s:%d: expected scan, portal or a dump line\n", fileName, lineNumber);
+				fclose(file);
+				return false;
+			}
+			rest = end + 1;
+			for (;;) {
+				unsigned long value = strtoul(rest, &end, 16);
+				if (end == rest) {
+					break;
+				}
+				line.data.push_back(value);
+				rest = end;
+			}
+		}
+
+		if (!traceLines.empty() && line.at < traceLines.back().at) {
+			fprintf(stderr, "%s:%d: time goes backwards\n", fileName, lineNumber);
+			fclose(file);
+			return false;
+		}
+		traceLines.push_back(line);
+	}
+
+	fclose(file);
+	return true;
+}
+
+static int modelScore(int player) {
+	return decodeBcd(gameRam + profileScoreAddress(machine, player), machine.scoreBytes);
+}
+
+static uint8_t modelState() {
+	return gameRam[machine.stateAddress] & machine.stateMask;
+}
+
+// ***** ATmega model *****
+
+static void atmegaFrame(byte type, const std::vector<uint8_t>& payload, uint64_t at) {
+	std::vector<uint8_t> frame;
+	uint16_t crc = 0xFFFF;
+
+	frame.push_back(FRAME_SYNC);
+	frame.push_back(type);
+	frame.push_back(payload.size() & 0xFF);
+	frame.push_back(payload.size() >> 8);
+	frame.insert(frame.end(), payload.begin(), payload.end());
+	for (size_t i = 1; i < frame.size(); i++) {
+		crc = crc16Update(crc, frame[i]);
+	}
+	frame.push_back(crc >> 8);
+	frame.push_back(crc & 0xFF);
+
+	Serial1.inject(at, frame.data(), frame.size());
+	atmegaFrames++;
+}
+
+static bool atmegaBcdValid() {
+	for (unsigned int i = 0; i < atmegaValidateRange.count; i++) {
+		uint8_t value = gameRam[atmegaValidateRange.start + i];
+		if ((value & 0x0F) > 9 || (value >> 4) > 9) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// sampleFrame() in atmel.ino
+static void atmegaSample(uint8_t id, const std::vector<AtmegaRange>& ranges, uint64_t at) {
+	std::vector<uint8_t> payload;
+
+	payload.push_back(id);
+	payload.push_back(atmegaValidate && atmegaBcdValid() ? SAMPLE_VALIDATED : 0);
+	payload.push_back(ranges.size());
+	for (const AtmegaRange& range : ranges) {
+		payload.push_back(range.start >> 8);
+		payload.push_back(range.start & 0xFF);
+		payload.push_back(range.count & 0xFF);
+		payload.push_back(range.count >> 8);
+		payload.insert(payload.end(), gameRam + range.start, gameRam + range.start + range.count);
+	}
+	atmegaFrame(FRAME_TYPE_SAMPLE, payload, at);
+}
+
+// address count pairs up to the end of the line, clamped to the RAM like sampleRead() does
+static std::vector<AtmegaRange> atmegaRanges(char* text) {
+	std::vector<AtmegaRange> ranges;
+	char* address;
+	char* count;
+
+	while ((address = strtok(text, " ")) != NULL && (count = strtok(NULL, " ")) != NULL) {
+		AtmegaRange range = { (unsigned int)strtoul(address, NULL, 0), (unsigned int)strtoul(count, NULL, 0) };
+		text = NULL;
+		if (range.start < ATMEGA_RAM_SIZE) {
+			range.count = min(range.count, ATMEGA_RAM_SIZE - range.start);
+			ranges.push_back(range);
+		}
+	}
+	return ranges;
+}
+
+// a command line from the ESP32, only the ones the firmware sends are understood
+static void atmegaCommand(char* text, uint64_t at) {
+	char* command = strtok(text, " ");
+
+	if (command == NULL) {
+		return;
+	}
+
+	if (strcasecmp(command, "validate") == 0) {
+		char* option = strtok(NULL, " ");
+		std::vector<AtmegaRange> ranges = atmegaRanges(NULL);
+
+		atmegaValidate = option != NULL && strcasecmp(option, "on") == 0;
+		if (!ranges.empty()) {
+			atmegaValidateRange = ranges[0];
+		}
+	} else if (strcasecmp(command, "watch") == 0) {
+		size_t bytes = 0;
+
+		atmegaWatch = atmegaRanges(NULL);
+		for (const AtmegaRange& range : atmegaWatch) {
+			bytes += range.count;
+		}
+		atmegaWatchSent.assign(bytes, 0);
+		atmegaWatchAll = true;
+		atmegaWatchNext = at + atmegaWatchUs;
+	} else if (strcasecmp(command, "watchinterval") == 0) {
+		char* ms = strtok(NULL, " ");
+
+		if (ms != NULL) {
+			atmegaWatchUs = min(max(strtoul(ms, NULL, 0), 2UL), 1000UL) * 1000;  // WATCH_MIN/MAX_INTERVAL_MS
+		}
+	} else if (strcasecmp(command, "mdump") == 0) {
+		char* id = strtok(NULL, " ");
+
+		if (id != NULL) {
+			atmegaSample(strtoul(id, NULL, 0), atmegaRanges(NULL), at + ATMEGA_REPLY_US);
+		}
+	} else if (strcasecmp(command, "stats") == 0) {
+		std::vector<uint8_t> payload(1 + ATMEGA_STATS_FIELDS * 4, 0);
+		unsigned long uptime = at / 1000;
+
+		payload[0] = ATMEGA_STATS_FIELDS;
+		for (int i = 0; i < 4; i++) {
+			payload[1 + i] = uptime >> (8 * i);
+		}
+		atmegaFrame(FRAME_TYPE_STATS, payload, at + ATMEGA_REPLY_US);
+	}
+}
+
+// lines the firmware wrote to the ATmega during the step that ended at end
+static void atmegaInput(uint64_t end) {
+	size_t newline;
+
+	atmegaLine += Serial1.output;
+	Serial1.output.clear();
+
+	while ((newline = atmegaLine.find('\n')) != std::string::npos) {
+		std::string line = atmegaLine.substr(0, newline);
+		atmegaLine.erase(0, newline + 1);
+
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+		atmegaCommand(&line[0], end + (newline + 1) * Serial1.byteUs());
+	}
+}
+
+// watchPoll() in atmel.ino
+static void atmegaWatchPoll(uint64_t now) {
+	bool changed = atmegaWatchAll;
+	size_t offset = 0;
+
+	if (atmegaValidate && !atmegaBcdValid()) {
+		return;  // a score half written, try again next poll
+	}
+
+	for (const AtmegaRange& range : atmegaWatch) {
+		for (unsigned int i = 0; i < range.count; i++) {
+			if (atmegaWatchSent[offset] != gameRam[range.start + i]) {
+				atmegaWatchSent[offset] = gameRam[range.start + i];
+				changed = true;
+			}
+			offset++;
+		}
+	}
+
+	if (changed) {
+		atmegaSample(WATCH_SAMPLE_ID, atmegaWatch, now);
+	}
+	atmegaWatchAll = false;
+}
+
+// ***** replay *****
+
+static void replayLine(const TraceLine& line, uint64_t now) {
+	static const char* hex = "0123456789ABCDEF";
+	int scoresBefore[NUM_MAX_PLAYERS];
+	uint8_t stateBefore = modelState();
+
+	switch (line.kind) {
+		case TRACE_WRITE:
+			for (int i = 0; i < NUM_MAX_PLAYERS; i++) {
+				scoresBefore[i] = modelScore(i);
+			}
+			for (size_t i = 0; i < line.data.size() && line.address + i < ATMEGA_RAM_SIZE; i++) {
+				gameRam[line.address + i] = line.data[i];
+			}
+
+			for (int i = 0; i < NUM_MAX_PLAYERS; i++) {
+				int score = modelScore(i);
+
+				if (score == scoresBefore[i]) {
+					continue;
+				}
+				latestScores[i] = { score, now, false };
+				if (modelState() != machine.stateInGame || score == 0) {
+					continue;  // storeGameUpdate() ignores these
+				}
+				scoreChanges++;
+				if (pendingScores[i].waiting) {
+					scoresCoalesced++;
+				}
+				pendingScores[i] = { score, now, true };
+			}
+
+			if (stateBefore == machine.stateInGame && modelState() == machine.stateIdle) {
+				gameOverAt = now;
+				gameOverWaiting = true;
+			}
+			break;
+
+		case TRACE_SCAN: {
+			// STX, 10 card characters, 2 checksum characters, CR LF, ETX
+			std::string frame = "\x02" + line.card.substr(0, RFID_CARD_LENGTH);
+			uint8_t checksum = 0;
+
+			for (size_t i = 0; i + 1 < frame.size() - 1; i += 2) {
+				checksum ^= strtoul(frame.substr(1 + i, 2).c_str(), NULL, 16);
+			}
+			frame += hex[checksum >> 4];
+			frame += hex[checksum & 0x0F];
+			frame += "\r\n\x03";
+			Serial2.inject(now, (const uint8_t*)frame.data(), frame.size());
+			break;
+		}
+
+		case TRACE_PORTAL:
+			hostPortalResult = line.result;
+			break;
+	}
+}
+
+// a pending score counts as detected once sharedGame holds it
+static void checkDetection(uint64_t at) {
+	for (int i = 0; i < NUM_MAX_PLAYERS; i++) {
+		if (pendingScores[i].waiting && sharedGame.playerScores[i] == pendingScores[i].value) {
+			detectMs.push_back((at - pendingScores[i].at) / 1000.0);
+			pendingScores[i].waiting = false;
+		}
+	}
+}
+
+static void checkPost(int player, int score, uint64_t at) {
+	scorePosts++;
+	if (player < 0 || player >= NUM_MAX_PLAYERS || latestScores[player].value != score) {
+		wrongScores++;
+		printf("> posted player %d score %d, the trace last wrote %d\n", player + 1, score,
+			player >= 0 && player < NUM_MAX_PLAYERS ? latestScores[player].value : 0);
+		return;
+	}
+	submitMs.push_back((at - latestScores[player].at) / 1000.0);
+}
+
+// score posts the portal accepted since the last call
+static void checkPortal() {
+	for (; portalSeen < hostPortalLog.size(); portalSeen++) {
+		const PortalRequest& request = hostPortalLog[portalSeen];
+		int player;
+		int score;
+
+		if (request.method != "POST" || request.result != HTTP_CODE_OK) {
+			continue;
+		}
+
+		if (request.path == "/pinball/score/") {
+			const char* playerText = strstr(request.body.c_str(), "player=");
+			const char* scoreText = strstr(request.body.c_str(), "score=");
+			if (playerText && scoreText && sscanf(playerText, "player=%d", &player) == 1 && sscanf(scoreText, "score=%d", &score) == 1) {
+				checkPost(player - 1, score, request.at);
+			}
+		} else if (request.path == "/pinball/scores/") {
+			const char* text = request.body.c_str();
+			while ((text = strstr(text, "{\"player\":")) != NULL) {
+				const char* scoreText = strstr(text, "\"score\":");
+				if (scoreText && sscanf(text, "{\"player\":%d", &player) == 1 && sscanf(scoreText, "\"score\":%d", &score) == 1) {
+					checkPost(player - 1, score, request.at);
+				}
+				text++;
+			}
+		} else {
+			continue;
+		}
+
+		if (gameOverWaiting) {
+			gameOverMs.push_back((request.at - gameOverAt) / 1000.0);
+			gameOverWaiting = false;
+		}
+	}
+}
+
+// one step of a pipeline task, or of loop() when task is NULL, returns when it wants to run next
+static uint64_t runStep(PipelineTask* task) {
+	uint64_t next;
+
+	hostStepUs = 0;
+	if (task != NULL) {
+		markTaskStep(task);
+		task->step();
+		// a task blocking on a queue is modelled as polling it every tick
+		next = hostMicros() + max(task->delayTicks, (TickType_t)1) * portTICK_PERIOD_MS * 1000;
+	} else {
+		loop();
+		next = hostMicros();
+	}
+
+	atmegaInput(hostMicros());
+	checkDetection(hostMicros());
+	checkPortal();
+	hostStepUs = 0;
+	return next;
+}
+
+static void printLatency(const char* name, std::vector<double>& samples, const char* meaning) {
+	if (samples.empty()) {
+		printf("> %-9s n    0  %s\n", name, meaning);
+		return;
+	}
+	std::sort(samples.begin(), samples.end());
+	printf("> %-9s n %4zu  min %8.1f  median %8.1f  p95 %8.1f  max %8.1f ms  %s\n", name, samples.size(),
+		samples.front(), samples[samples.size() / 2], samples[(samples.size() * 95) / 100 < samples.size() ? (samples.size() * 95) / 100 : samples.size() - 1],
+		samples.back(), meaning);
+}
+
+static double wallSeconds() {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// ***** main *****
+
+int main(int argc, char** argv) {
+	const char* traceFile = NULL;
+	uint64_t taskNext[NUM_PIPELINE_TASKS];
+	uint64_t loopNext;
+	uint64_t traceStart = 0;
+	uint64_t traceEnd = 0;
+	bool ready = false;
+	size_t nextLine = 0;
+	double wallStart = wallSeconds();
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--verbose") == 0) {
+			verbose = true;
+		} else if (strcmp(argv[i], "--metrics") == 0) {
+			showMetrics = true;
+		} else if (strcmp(argv[i], "--portal-ms") == 0 && i + 1 < argc) {
+			hostPortalUs = strtoul(argv[++i], NULL, 0) * 1000;
+		} else if (strcmp(argv[i], "--connect-ms") == 0 && i + 1 < argc) {
+			hostConnectUs = strtoul(argv[++i], NULL, 0) * 1000;
+		} else if (strcmp(argv[i], "--tail") == 0 && i + 1 < argc) {
+			tailMs = strtoul(argv[++i], NULL, 0);
+		} else if (argv[i][0] != '-' && traceFile == NULL) {
+			traceFile = argv[i];
+		} else {
+			fprintf(stderr, "usage: %s [--verbose] [--metrics] [--portal-ms ms] [--connect-ms ms] [--tail ms] trace\n", argv[0]);
+			return 1;
+		}
+	}
+	if (traceFile == NULL || !loadTrace(traceFile)) {
+		if (traceFile == NULL) {
+			fprintf(stderr, "usage: %s [options] trace\n", argv[0]);
+		}
+		return 1;
+	}
+
+	Serial.echo = verbose;
+	Serial1.echo = verbose;
+	Serial1.capture = true;
+
+	// lines at time 0 are the game RAM from power on
+	for (; nextLine < traceLines.size() && traceLines[nextLine].at == 0; nextLine++) {
+		replayLine(traceLines[nextLine], 0);
+	}
+	memset(pendingScores, 0, sizeof(pendingScores));
+	scoreChanges = 0;
+
+	setup();
+	hostNow = hostMicros();
+	hostStepUs = 0;
+	atmegaInput(hostNow);
+	for (int i = 0; i < NUM_PIPELINE_TASKS; i++) {
+		taskNext[i] = hostNow;
+	}
+	loopNext = hostNow;
+
+	for (;;) {
+		uint64_t now = loopNext;
+
+		for (int i = 0; i < NUM_PIPELINE_TASKS; i++) {
+			now = min(now, taskNext[i]);
+		}
+		if (!atmegaWatch.empty()) {
+			now = min(now, atmegaWatchNext);
+		}
+		if (ready && nextLine < traceLines.size()) {
+			now = min(now, traceStart + traceLines[nextLine].at);
+		}
+		// past the tail, keep going while scores wait in the journal, up to two of its longest backoffs
+		if (ready && now > traceEnd && (journalPending() == 0 || now > traceEnd + 2000ULL * JOURNAL_RETRY_MAX_MS)) {
+			break;
+		}
+		if (!ready && now > READY_TIMEOUT_US) {
+			printf("> the controller never reached idle, state %d\n", controllerState);
+			return 1;
+		}
+		hostNow = now;
+
+		for (; ready && nextLine < traceLines.size() && traceStart + traceLines[nextLine].at <= now; nextLine++) {
+			replayLine(traceLines[nextLine], now);
+		}
+		if (!atmegaWatch.empty() && atmegaWatchNext <= now) {
+			atmegaWatchPoll(now);
+			atmegaWatchPolls++;
+			atmegaWatchNext = now + atmegaWatchUs;
+		}
+		for (int i = 0; i < NUM_PIPELINE_TASKS; i++) {
+			if (taskNext[i] <= now) {
+				taskNext[i] = runStep(&pipelineTasks[i]);
+			}
+		}
+		if (loopNext <= now) {
+			loopNext = runStep(NULL);
+		}
+
+		if (!ready && controllerState == CONTROLLER_IDLE) {
+			ready = true;
+			traceStart = now;
+			traceEnd = traceStart + (traceLines.empty() ? 0 : traceLines.back().at) + tailMs * 1000;
+			if (verbose) {
+				printf("%10.3f replay trace starts\n", now / 1e6);
+			}
+		}
+	}
+
+	unsigned long missed = 0;
+	for (int i = 0; i < NUM_MAX_PLAYERS; i++) {
+		missed += pendingScores[i].waiting;
+	}
+
+	printf("> replay %s, %zu lines, %.1f s simulated in %.2f s\n", traceFile, traceLines.size(), hostNow / 1e6,
+		wallSeconds() - wallStart);
+	printf("> score changes %lu in game, detected %zu, coalesced %lu, missed %lu\n", scoreChanges, detectMs.size(),
+		scoresCoalesced, missed);
+	printLatency("detect", detectMs, "score written to sharedGame");
+	printLatency("submit", submitMs, "last write of the score to its POST");
+	printLatency("game over", gameOverMs, "game over to the first score POST");
+	if (journalPending() > 0) {
+		printf("> %lu scores still in the journal\n", journalPending());
+	}
+	printf("> portal requests %zu, score posts %lu, wrong scores %lu, ATmega frames %lu, frame errors %lu\n",
+		hostPortalLog.size(), scorePosts, wrongScores, atmegaFrames, frameErrors);
+	printf("> ATmega watch polls %lu, each one a pass over the watched RAM the 6800 is using\n", atmegaWatchPolls);
+
+	if (showMetrics) {
+		std::string body;
+		if (server.request("/metrics", body)) {
+			fputs(body.c_str(), stdout);
+		}
+	}
+
+	return wrongScores > 0 ? 1 : 0;
+}
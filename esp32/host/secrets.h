@@ -0,0 +1,7 @@
+// secrets.h
+// host build only, the portal is the stand-in in EspHost.cpp
+
+#define WIFI_SSID "host"
+#define WIFI_PASS ""
+
+#define PINBALL_API_TOKEN "Bearer host"
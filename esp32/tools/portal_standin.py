@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+# Stand-in for the portal pinball API so the ESP32 can be tested without the real portal.
+#
+#   python3 portal_standin.py [--port 8000]
+#
+# then in secrets.h
+#   #define PORTAL_API_URL "http://<this machine's IP>:8000"
+#
+# Speaks HTTP/1.1 with keep-alive and logs each new connection, so you can see the ESP32
+# reuse one connection for heartbeat, name lookup and score posts.
+
+import argparse
+import json
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs
+
+NAMES = {}  # card number -> (name, drink), anything else gets a made up player
+
+
+class PortalHandler(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+
+    def setup(self):
+        super().setup()
+        self.requests_on_connection = 0
+        print('connection from %s:%d' % self.client_address, flush=True)
+
+    def reply(self, code, body, content_type='application/json'):
+        data = body.encode()
+        self.send_response(code)
+        self.send_header('Content-Type', content_type)
+        self.send_header('Content-Length', str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+    def log_request(self, code='-', size='-'):
+        self.requests_on_connection += 1
+        print('  %s %s -> %s (request %d on this connection)' % (
+            self.command, self.path, code, self.requests_on_connection), flush=True)
+
+    def do_GET(self):
+        if self.path == '/stats/':
+            self.reply(200, json.dumps({'member_count': 0}))
+            return
+
+        parts = self.path.strip('/').split('/')
+        if len(parts) == 3 and parts[0] == 'pinball' and parts[2] == 'get_name':
+            name, drink = NAMES.get(parts[1], ('Player ' + parts[1][-4:], 'Root Beer'))
+            self.reply(200, json.dumps({'name': name, 'drink': drink}))
+            return
+
+        self.reply(404, json.dumps({'error': 'not found'}))
+
+    def do_POST(self):
+        length = int(self.headers.get('Content-Length', 0))
+        body = self.rfile.read(length).decode()
+
+        if self.path == '/pinball/score/':
+            print('  score', {k: v[0] for k, v in parse_qs(body).items()}, flush=True)
+            self.reply(200, json.dumps({'ok': True}))
+            return
+
+        if self.path == '/pinball/scores/':
+            print('  scores', json.loads(body), flush=True)
+            self.reply(200, json.dumps({'ok': True}))
+            return
+
+        self.reply(404, json.dumps({'error': 'not found'}))
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--port', type=int, default=8000)
+    args = parser.parse_args()
+
+    server = ThreadingHTTPServer(('', args.port), PortalHandler)
+    print('portal stand-in on port %d' % args.port, flush=True)
+    server.serve_forever()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,69 @@
+// MachineProfile.h
+// game RAM layout of each pinball title the memory tap knows, shared by atmel.ino and esp32.ino
+//
+// The ATmega uses the score block to check BCD in validate, the ESP32 decodes game state, player and
+// scores through it and asks for sampleRanges. Everything is constexpr, so the decode compiles to the
+// same constant addresses and masks the hand written version had.
+//
+// A second title is a new row in machineProfiles and a MACHINE_* index for it, build both sketches
+// with -DMACHINE_PROFILE=MACHINE_<name> or change the default below. tools/memmap finds the addresses
+// from labeled dumps and prints sampleRanges.
+//
+// Arduino only builds headers from the sketch folder or a library, so this lives in libraries/.
+// Put it in the sketchbook libraries folder or pass --libraries ../libraries to arduino-cli.
+
+#ifndef MACHINE_PROFILE_H
+#define MACHINE_PROFILE_H
+
+#include <stdint.h>
+
+#define MACHINE_NO_VALUE 0xFF       // state byte value that doesn't occur on this title
+
+struct MachineProfile {
+  const char *name;
+  uint16_t stateAddress;            // game state byte, masked then compared with the three values below
+  uint8_t stateMask;
+  uint8_t stateInGame;
+  uint8_t stateIdle;
+  uint8_t stateSettings;
+  uint16_t playerAddress;           // current player, masked value minus playerFirst is 0 for player 1
+  uint8_t playerMask;
+  uint8_t playerFirst;
+  uint8_t players;
+  uint16_t scoreAddress;            // player 1 score, big endian BCD
+  uint8_t scoreBytes;
+  uint8_t scoreStride;              // scoreAddress of the next player is this much higher
+  const char *sampleRanges;         // mdump / watch ranges holding all of the above
+};
+
+#define MACHINE_PROTOSPACE 0
+
+constexpr MachineProfile machineProfiles[] = {
+  // the 6800 machine at Protospace, the one dumps/*.txt came from
+  { "protospace", 0x00A9, 0x0F, 0, 1, 2, 0x00AD, 0x0F, 0, 4, 0x0200, 4, 4, "0x00A9 5 0x0200 16" },
+};
+
+#ifndef MACHINE_PROFILE
+#define MACHINE_PROFILE MACHINE_PROTOSPACE
+#endif
+
+constexpr const MachineProfile &machine = machineProfiles[MACHINE_PROFILE];
+
+// ***** profileCovers *****
+// a block of count bytes read from start holds width bytes at address
+constexpr bool profileCovers(unsigned int address, unsigned int width, unsigned int start, unsigned int count){
+  return (start <= address) && (address + width <= start + count);
+}
+
+// ***** profileScoreAddress *****
+constexpr unsigned int profileScoreAddress(const MachineProfile &profile, unsigned int player){
+  return profile.scoreAddress + player * profile.scoreStride;
+}
+
+// ***** profileScoreBlock *****
+// bytes from scoreAddress to the end of the last player's score
+constexpr unsigned int profileScoreBlock(const MachineProfile &profile){
+  return (profile.players - 1) * profile.scoreStride + profile.scoreBytes;
+}
+
+#endif
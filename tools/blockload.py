@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+# blockload.py
+# 2026-10-17 send a saved RAM image to the ATmega with bload / gamebload
+#
+# Reads a dumps/*.txt file (the "0xAAAA: 0xNN ..." lines from dump or gameDump) or an Intel HEX file
+# from save / gamesave, starts bload on the ATmega and sends the image as FRAME_TYPE_BLOCK frames.
+# Each frame waits for its FRAME_TYPE_ACK before the next one goes, a NAK resends from the address
+# the ATmega asks for. Giving up sends a FRAME_TYPE_STOP frame so the ATmega goes back to command input
+# straight away instead of waiting out its timeout.
+#
+#   python3 tools/blockload.py /dev/ttyUSB0 dumps/player1.txt            shadow RAM
+#   python3 tools/blockload.py /dev/ttyUSB0 dumps/player1.txt --game     live game RAM, pinball powered off
+#
+# Needs pyserial.
+
+import argparse
+import sys
+import time
+
+import serial
+
+FRAME_SYNC = 0xA5
+FRAME_TYPE_BLOCK = ord('B')
+FRAME_TYPE_ACK = ord('A')
+FRAME_TYPE_STOP = ord('X')
+BLOCK_MAX_DATA = 256
+ACK_STATUS = {0: "ok", 1: "bad CRC", 2: "bad address", 3: "verify failed"}
+
+
+def crc16(data, crc=0xFFFF):
+    # CRC-16/CCITT-FALSE, same as crc16Update in atmel.ino
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
+
+def frame(frameType, payload):
+    body = bytes([frameType, len(payload) & 0xFF, len(payload) >> 8]) + payload
+    crc = crc16(body)
+    return bytes([FRAME_SYNC]) + body + bytes([crc >> 8, crc & 0xFF])
+
+
+def readImage(path):
+    # returns {address: byte}
+    image = {}
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if line.startswith(':'):                  # Intel HEX data record
+                record = bytes.fromhex(line[1:])
+                if (sum(record) & 0xFF) or record[3] != 0:
+                    continue
+                address = (record[1] << 8) | record[2]
+                for i, b in enumerate(record[4:4 + record[0]]):
+                    image[address + i] = b
+            elif line.lower().startswith('0x') and ':' in line:
+                head, data = line.split(':', 1)
+                address = int(head, 16)
+                for i, text in enumerate(data.split()):
+                    image[address + i] = int(text, 16)
+    return image
+
+
+def readAck(port, timeout):
+    # hunt for the next ACK frame, anything else on the serial line is text from the ATmega
+    deadline = time.monotonic() + timeout
+    state = []
+    while time.monotonic() < deadline:
+        c = port.read(1)
+        if not c:
+            continue
+        c = c[0]
+        if not state:
+            if c == FRAME_SYNC:
+                state.append(c)
+            continue
+        state.append(c)
+        if len(state) == 2 and c != FRAME_TYPE_ACK:
+            state = []
+        elif len(state) == 9:
+            body, crc = bytes(state[1:7]), (state[7] << 8) | state[8]
+            state = []
+            if crc16(body) == crc:
+                return body[3], (body[4] << 8) | body[5]
+    return None, None
+
+
+def main():
+    parser = argparse.ArgumentParser(description="load a saved RAM image with bload")
+    parser.add_argument("port")
+    parser.add_argument("image")
+    parser.add_argument("--game", action="store_true", help="load the live game RAM instead of the shadow RAM")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--retries", type=int, default=5, help="NAKs allowed for one block")
+    args = parser.parse_args()
+
+    image = readImage(args.image)
+    if not image:
+        sys.exit("no data in " + args.image)
+    start, end = min(image), max(image) + 1
+    data = bytes(image.get(a, 0) for a in range(start, end))
+
+    port = serial.Serial(args.port, args.baud, timeout=0.05)
+    port.reset_input_buffer()
+    command = "gamebload" if args.game else "bload"
+    began = time.monotonic()
+    port.write(("%s 0x%04X %d\n" % (command, start, len(data))).encode())
+
+    status, nextAddress = readAck(port, 2.0)
+    if status != 0:
+        sys.exit("%s was not accepted" % command)
+
+    naks = 0
+    tries = 0
+    while nextAddress < end:
+        offset = nextAddress - start
+        chunk = data[offset:offset + BLOCK_MAX_DATA]
+        port.write(frame(FRAME_TYPE_BLOCK, bytes([nextAddress >> 8, nextAddress & 0xFF]) + chunk))
+        status, answer = readAck(port, 1.0)
+        if status == 0:
+            nextAddress = answer
+            tries = 0
+            continue
+        naks += 1
+        tries += 1
+        print("0x%04X: %s" % (nextAddress, ACK_STATUS.get(status, "no answer")), file=sys.stderr)
+        if tries > args.retries:
+            port.write(frame(FRAME_TYPE_STOP, b""))
+            sys.exit("giving up at 0x%04X" % nextAddress)
+        if answer is not None:
+            nextAddress = answer
+
+    print("%d bytes 0x%04X-0x%04X in %.3f s, %d NAKs" % (len(data), start, end - 1, time.monotonic() - began, naks))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,467 @@
+// memmap.cpp
+// find where the game keeps a value by comparing labeled dumps/*.txt snapshots
+//
+//   ./memmap [options] labels.txt             rank the addresses that follow each label, optionally write a header
+//   ./memmap --diff a.txt b.txt               list the bytes that differ between two snapshots
+//
+// labels.txt has one snapshot per line, the file name relative to labels.txt then label=value pairs:
+//   player2.txt  state=0 player=1
+// A label is tested against every address as the whole byte, the low or high nibble, each with or
+// without a +1 (0 or 1 based counters), and as big endian BCD of 1 to 4 bytes. Candidates are ranked by
+// the snapshots they explain, then by the simplest decode.
+//
+// see README.md for the options
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#define RAM_SIZE 2048
+#define MAX_BCD_BYTES 4
+#define DEFAULT_TOP 5
+#define DEFAULT_MERGE_GAP 4         // an extra mdump range costs 4 header bytes, read a short gap instead
+#define RANGE_HEADER_BYTES 4        // address high, address low, count low, count high in an 'M' frame
+
+struct Snapshot {
+  std::string fileName;
+  unsigned char image[RAM_SIZE];
+  bool present[RAM_SIZE];
+  std::vector<std::pair<std::string, long> > labels;
+};
+
+// how a value is read out of RAM, in order of preference when two explain the same snapshots
+enum Decode { DECODE_BYTE, DECODE_LOW, DECODE_HIGH, DECODE_BCD };
+static const char *decodeNames[] = { "byte", "low nibble", "high nibble", "BCD" };
+
+struct Candidate {
+  unsigned int address;
+  Decode decode;
+  int width;                        // bytes, only BCD uses more than one
+  int offset;                       // label = decoded + offset
+  int matches;                      // snapshots explained
+  int labeled;                      // snapshots carrying the label
+  int pairs;                        // snapshot pairs where "same label" and "same decoded value" agree
+};
+
+struct Range {
+  unsigned int start;
+  unsigned int count;
+};
+
+static std::vector<Snapshot> snapshots;
+static std::vector<Range> keepRanges;
+static int topCount = DEFAULT_TOP;
+static unsigned int mergeGap = DEFAULT_MERGE_GAP;
+static const char *headerFile = NULL;
+
+// ***** loadDump *****
+// read a dumps/*.txt style file, "0x0000: 0x48 0x00 ..."
+static bool loadDump(const char *fileName, Snapshot &snapshot){
+  FILE *file = fopen(fileName, "r");
+  if (file == NULL) return false;
+
+  snapshot.fileName = fileName;
+  memset(snapshot.image, 0, sizeof(snapshot.image));
+  memset(snapshot.present, 0, sizeof(snapshot.present));
+
+  char line[256];
+  while (fgets(line, sizeof(line), file)) {
+    char *text = line;
+    char *end;
+    unsigned long address = strtoul(text, &end, 16);
+    if ((end == text) || (*end != ':')) continue;
+    text = end + 1;
+    for (;;) {
+      unsigned long value = strtoul(text, &end, 16);
+      if (end == text) break;
+      if (address < RAM_SIZE) {
+        snapshot.image[address] = value;
+        snapshot.present[address++] = true;
+      }
+      text = end;
+    }
+  }
+  fclose(file);
+  return true;
+}
+
+// ***** loadLabels *****
+static bool loadLabels(const char *labelsFile){
+  FILE *file = fopen(labelsFile, "r");
+  if (file == NULL) {
+    fprintf(stderr, "can't read %s\n", labelsFile);
+    return false;
+  }
+
+  std::string directory = labelsFile;
+  size_t slash = directory.rfind('/');
+  directory = (slash == std::string::npos) ? "" : directory.substr(0, slash + 1);
+
+  char line[512];
+  int lineNumber = 0;
+  while (fgets(line, sizeof(line), file)) {
+    lineNumber++;
+    char *comment = strchr(line, '#');
+    if (comment) *comment = 0;
+
+    char *word = strtok(line, " \t\r\n");
+    if (word == NULL) continue;
+
+    Snapshot snapshot;
+    std::string fileName = (word[0] == '/') ? word : directory + word;
+    if (!loadDump(fileName.c_str(), snapshot)) {
+      fprintf(stderr, "%s:%d can't read %s\n", labelsFile, lineNumber, fileName.c_str());
+      fclose(file);
+      return false;
+    }
+    while ((word = strtok(NULL, " \t\r\n")) != NULL) {
+      char *equals = strchr(word, '=');
+      if (equals == NULL) {
+        fprintf(stderr, "%s:%d expected label=value, got %s\n", labelsFile, lineNumber, word);
+        fclose(file);
+        return false;
+      }
+      *equals = 0;
+      snapshot.labels.push_back(std::make_pair(std::string(word), strtol(equals + 1, NULL, 0)));
+    }
+    snapshots.push_back(snapshot);
+  }
+  fclose(file);
+  return true;
+}
+
+// ***** labelValue *****
+static bool labelValue(const Snapshot &snapshot, const std::string &label, long &value){
+  for (size_t i = 0; i < snapshot.labels.size(); i++) {
+    if (snapshot.labels[i].first == label) {
+      value = snapshot.labels[i].second;
+      return true;
+    }
+  }
+  return false;
+}
+
+// ***** decodeAt *****
+// false when the bytes are missing from the snapshot or aren't valid BCD
+static bool decodeAt(const Snapshot &snapshot, unsigned int address, Decode decode, int width, long &value){
+  if (address + width > RAM_SIZE) return false;
+  for (int i = 0; i < width; i++) {
+    if (!snapshot.present[address + i]) return false;
+  }
+
+  unsigned char dataByte = snapshot.image[address];
+  switch (decode) {
+    case DECODE_BYTE:
+      value = dataByte;
+      return true;
+    case DECODE_LOW:
+      value = dataByte & 0x0F;
+      return true;
+    case DECODE_HIGH:
+      value = dataByte >> 4;
+      return true;
+    case DECODE_BCD:
+      value = 0;
+      for (int i = 0; i < width; i++) {
+        dataByte = snapshot.image[address + i];
+        if (((dataByte >> 4) > 9) || ((dataByte & 0x0F) > 9)) return false;
+        value = value * 100 + (dataByte >> 4) * 10 + (dataByte & 0x0F);
+      }
+      return true;
+  }
+  return false;
+}
+
+// ***** scoreCandidate *****
+static void scoreCandidate(Candidate &candidate, const std::vector<const Snapshot *> &labeled, const std::string &label){
+  std::vector<long> decoded(labeled.size());
+  std::vector<bool> valid(labeled.size());
+  std::vector<long> wanted(labeled.size());
+
+  candidate.matches = 0;
+  for (size_t i = 0; i < labeled.size(); i++) {
+    labelValue(*labeled[i], label, wanted[i]);
+    valid[i] = decodeAt(*labeled[i], candidate.address, candidate.decode, candidate.width, decoded[i]);
+    if (valid[i] && (decoded[i] + candidate.offset == wanted[i])) candidate.matches++;
+  }
+
+  candidate.pairs = 0;
+  for (size_t i = 0; i < labeled.size(); i++) {
+    for (size_t j = i + 1; j < labeled.size(); j++) {
+      if (!valid[i] || !valid[j]) continue;
+      if ((wanted[i] == wanted[j]) == (decoded[i] == decoded[j])) candidate.pairs++;
+    }
+  }
+}
+
+// ***** betterCandidate *****
+// most snapshots explained, then pairs, then the simplest decode, then the lowest address
+static bool betterCandidate(const Candidate &a, const Candidate &b){
+  if (a.matches != b.matches) return a.matches > b.matches;
+  if (a.pairs != b.pairs) return a.pairs > b.pairs;
+  if (a.width != b.width) return a.width < b.width;
+  if (a.decode != b.decode) return a.decode < b.decode;
+  if (a.offset != b.offset) return a.offset < b.offset;
+  return a.address < b.address;
+}
+
+// ***** rankLabel *****
+static std::vector<Candidate> rankLabel(const std::string &label){
+  std::vector<const Snapshot *> labeled;
+  long first = 0;
+  bool varies = false;
+  for (size_t i = 0; i < snapshots.size(); i++) {
+    long value;
+    if (!labelValue(snapshots[i], label, value)) continue;
+    if (labeled.empty()) first = value;
+    else if (value != first) varies = true;
+    labeled.push_back(&snapshots[i]);
+  }
+
+  std::vector<Candidate> candidates;
+  if (!varies) {
+    printf("%s: same value in all %u snapshots, nothing to tell the addresses apart\n\n", label.c_str(), (unsigned)labeled.size());
+    return candidates;
+  }
+
+  for (unsigned int address = 0; address < RAM_SIZE; address++) {
+    for (int decode = DECODE_BYTE; decode <= DECODE_BCD; decode++) {
+      int widths = (decode == DECODE_BCD) ? MAX_BCD_BYTES : 1;
+      for (int width = 1; width <= widths; width++) {
+        for (int offset = 0; offset <= 1; offset++) {
+          if ((decode == DECODE_BCD) && offset) continue;
+          Candidate candidate = { address, (Decode)decode, width, offset, 0, (int)labeled.size(), 0 };
+          scoreCandidate(candidate, labeled, label);
+          if (candidate.matches > 0) candidates.push_back(candidate);
+        }
+      }
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(), betterCandidate);
+
+  unsigned int totalPairs = labeled.size() * (labeled.size() - 1) / 2;
+  unsigned int exact = 0;
+  while ((exact < candidates.size()) && (candidates[exact].matches == (int)labeled.size())) exact++;
+  printf("%s: %u snapshots, %u decodes explain all of them\n", label.c_str(), (unsigned)labeled.size(), exact);
+  for (int i = 0; (i < topCount) && (i < (int)candidates.size()); i++) {
+    const Candidate &c = candidates[i];
+    printf("  0x%04X  %-11s", c.address, decodeNames[c.decode]);
+    if (c.decode == DECODE_BCD) printf(" %d byte%s", c.width, (c.width > 1) ? "s" : " ");
+    else printf(" %s   ", c.offset ? "+1" : "  ");
+    printf("  %u/%u snapshots  %u/%u pairs\n", c.matches, (unsigned)labeled.size(), c.pairs, totalPairs);
+  }
+  printf("\n");
+  return candidates;
+}
+
+// ***** labelNames *****
+static std::vector<std::string> labelNames(){
+  std::vector<std::string> names;
+  for (size_t i = 0; i < snapshots.size(); i++) {
+    for (size_t j = 0; j < snapshots[i].labels.size(); j++) {
+      if (std::find(names.begin(), names.end(), snapshots[i].labels[j].first) == names.end()) {
+        names.push_back(snapshots[i].labels[j].first);
+      }
+    }
+  }
+  return names;
+}
+
+// ***** mergeRanges *****
+// sort and join ranges closer than mergeGap, fewer ranges means fewer CE setups and frame headers
+static std::vector<Range> mergeRanges(std::vector<Range> ranges){
+  std::sort(ranges.begin(), ranges.end(), [](const Range &a, const Range &b) { return a.start < b.start; });
+
+  std::vector<Range> merged;
+  for (size_t i = 0; i < ranges.size(); i++) {
+    if (!merged.empty() && (ranges[i].start <= merged.back().start + merged.back().count + mergeGap)) {
+      unsigned int end = std::max(merged.back().start + merged.back().count, ranges[i].start + ranges[i].count);
+      merged.back().count = end - merged.back().start;
+    }
+    else merged.push_back(ranges[i]);
+  }
+  return merged;
+}
+
+// ***** readCost *****
+// bytes one mdump of the ranges puts on the link, data plus a header per range after merging
+static unsigned int readCost(const std::vector<Range> &ranges){
+  std::vector<Range> merged = mergeRanges(ranges);
+  unsigned int cost = 0;
+  for (size_t i = 0; i < merged.size(); i++) cost += merged[i].count + RANGE_HEADER_BYTES;
+  return cost;
+}
+
+// ***** chooseCandidates *****
+// the best decode for each label. When several rank the same, take the one that adds least to one
+// mdump of the keep ranges and everything chosen so far. Labels with the fewest ties choose first.
+static std::vector<std::pair<std::string, Candidate> > chooseCandidates(const std::vector<std::string> &names,
+                                                                       const std::vector<std::vector<Candidate> > &ranked){
+  std::vector<size_t> ties(names.size(), 0);
+  for (size_t i = 0; i < names.size(); i++) {
+    const std::vector<Candidate> &candidates = ranked[i];
+    while ((ties[i] < candidates.size()) && (candidates[ties[i]].matches == candidates[0].matches) &&
+           (candidates[ties[i]].pairs == candidates[0].pairs)) ties[i]++;
+  }
+
+  std::vector<size_t> order;
+  for (size_t i = 0; i < names.size(); i++) {
+    if (ties[i]) order.push_back(i);
+  }
+  std::stable_sort(order.begin(), order.end(), [&ties](size_t a, size_t b) { return ties[a] < ties[b]; });
+
+  std::vector<Range> ranges = keepRanges;
+  std::vector<std::pair<std::string, Candidate> > chosen;
+  for (size_t n = 0; n < order.size(); n++) {
+    const std::vector<Candidate> &candidates = ranked[order[n]];
+    size_t best = 0;
+    unsigned int bestCost = 0;
+    for (size_t i = 0; i < ties[order[n]]; i++) {
+      std::vector<Range> trial = ranges;
+      Range range = { candidates[i].address, (unsigned int)candidates[i].width };
+      trial.push_back(range);
+      unsigned int cost = readCost(trial);
+      if ((i == 0) || (cost < bestCost)) {
+        best = i;
+        bestCost = cost;
+      }
+    }
+    Range range = { candidates[best].address, (unsigned int)candidates[best].width };
+    ranges.push_back(range);
+    chosen.push_back(std::make_pair(names[order[n]], candidates[best]));
+  }
+  return chosen;
+}
+
+// ***** upperName *****
+static std::string upperName(const std::string &label){
+  std::string name;
+  for (size_t i = 0; i < label.size(); i++) {
+    char c = label[i];
+    name += isalnum((unsigned char)c) ? (char)toupper((unsigned char)c) : '_';
+  }
+  return name;
+}
+
+// ***** writeHeader *****
+static bool writeHeader(const char *labelsFile, const std::vector<std::pair<std::string, Candidate> > &chosen){
+  FILE *file = fopen(headerFile, "w");
+  if (file == NULL) {
+    fprintf(stderr, "can't write %s\n", headerFile);
+    return false;
+  }
+
+  fprintf(file, "// %s\n", headerFile);
+  fprintf(file, "// written by tools/memmap from %s, %u snapshots\n", labelsFile, (unsigned)snapshots.size());
+  fprintf(file, "// label = decoded value + OFFSET, DECODE is 0 byte, 1 low nibble, 2 high nibble, 3 big endian BCD\n\n");
+
+  std::vector<Range> ranges = keepRanges;
+  for (size_t i = 0; i < chosen.size(); i++) {
+    const Candidate &c = chosen[i].second;
+    std::string name = "MEMMAP_" + upperName(chosen[i].first);
+    fprintf(file, "#define %s_ADDRESS 0x%04X  // %s, %d of %d snapshots\n", name.c_str(), c.address,
+            decodeNames[c.decode], c.matches, c.labeled);
+    fprintf(file, "#define %s_DECODE %d\n", name.c_str(), c.decode);
+    fprintf(file, "#define %s_WIDTH %d\n", name.c_str(), c.width);
+    fprintf(file, "#define %s_OFFSET %d\n\n", name.c_str(), c.offset);
+    Range range = { c.address, (unsigned int)c.width };
+    ranges.push_back(range);
+  }
+
+  ranges = mergeRanges(ranges);
+  std::string text;
+  unsigned int total = 0;
+  for (size_t i = 0; i < ranges.size(); i++) {
+    char part[24];
+    snprintf(part, sizeof(part), "%s0x%04X %u", i ? " " : "", ranges[i].start, ranges[i].count);
+    text += part;
+    total += ranges[i].count;
+  }
+  fprintf(file, "// everything above in %u bytes, %u on the link with the range headers, for mdump and watch\n",
+          total, readCost(ranges));
+  fprintf(file, "#define MEMMAP_RANGES \"%s\"\n", text.c_str());
+  fclose(file);
+  printf("wrote %s, ranges %s (%u bytes)\n", headerFile, text.c_str(), total);
+  return true;
+}
+
+// ***** diffSnapshots *****
+static int diffSnapshots(const char *fileA, const char *fileB){
+  Snapshot a, b;
+  if (!loadDump(fileA, a) || !loadDump(fileB, b)) {
+    fprintf(stderr, "can't read %s or %s\n", fileA, fileB);
+    return 1;
+  }
+
+  unsigned int differ = 0;
+  for (unsigned int address = 0; address < RAM_SIZE; address++) {
+    if (!a.present[address] || !b.present[address]) continue;
+    if (a.image[address] == b.image[address]) continue;
+    printf("0x%04X: 0x%02X 0x%02X\n", address, a.image[address], b.image[address]);
+    differ++;
+  }
+  printf("%u bytes differ\n", differ);
+  return 0;
+}
+
+// ***** usage *****
+static void usage(){
+  fprintf(stderr,
+    "usage: memmap [--top n] [--keep addr count] [--gap n] [--header file.h] labels.txt\n"
+    "       memmap --diff a.txt b.txt\n");
+}
+
+int main(int argc, char **argv){
+  const char *labelsFile = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if ((arg == "--diff") && (i + 2 < argc)) return diffSnapshots(argv[i + 1], argv[i + 2]);
+    else if ((arg == "--top") && (i + 1 < argc)) topCount = atoi(argv[++i]);
+    else if ((arg == "--gap") && (i + 1 < argc)) mergeGap = strtoul(argv[++i], NULL, 0);
+    else if ((arg == "--header") && (i + 1 < argc)) headerFile = argv[++i];
+    else if ((arg == "--keep") && (i + 2 < argc)) {
+      Range range = { (unsigned int)strtoul(argv[i + 1], NULL, 0), (unsigned int)strtoul(argv[i + 2], NULL, 0) };
+      keepRanges.push_back(range);
+      i += 2;
+    }
+    else if ((arg[0] != '-') && (labelsFile == NULL)) labelsFile = argv[i];
+    else {
+      usage();
+      return 1;
+    }
+  }
+  if (labelsFile == NULL) {
+    usage();
+    return 1;
+  }
+  if (!loadLabels(labelsFile)) return 1;
+
+  unsigned int varying = 0;
+  for (unsigned int address = 0; address < RAM_SIZE; address++) {
+    for (size_t i = 1; i < snapshots.size(); i++) {
+      if (snapshots[i].image[address] != snapshots[0].image[address]) {
+        varying++;
+        break;
+      }
+    }
+  }
+  printf("%u snapshots, %u of %d bytes differ somewhere\n\n", (unsigned)snapshots.size(), varying, RAM_SIZE);
+
+  std::vector<std::string> names = labelNames();
+  std::vector<std::vector<Candidate> > ranked;
+  for (size_t i = 0; i < names.size(); i++) ranked.push_back(rankLabel(names[i]));
+
+  std::vector<std::pair<std::string, Candidate> > chosen = chooseCandidates(names, ranked);
+  for (size_t i = 0; i < chosen.size(); i++) {
+    const Candidate &c = chosen[i].second;
+    printf("%s: 0x%04X %s%s\n", chosen[i].first.c_str(), c.address, decodeNames[c.decode], c.offset ? " +1" : "");
+  }
+
+  if (headerFile && !writeHeader(labelsFile, chosen)) return 1;
+  return 0;
+}